@@ -0,0 +1,116 @@
+#!/bin/bash
+
+# Click-to-open latency: runs open_lnk on every .lnk of a corpus the way a file
+# manager does, with xdg-open and notify-send replaced by stubs that log when
+# they are reached. Reports the time from process start to the launch of the
+# target, once with the page cache dropped (cold) and once with it warm.
+#
+#   ./clickLatency.sh [-n RUNS] [-o RAW.tsv] OPEN_LNK CORPUS_DIR
+#
+# Cold runs drop the whole page cache when run as root, otherwise they evict
+# the binary and the shortcut from it with dd iflag=nocache.
+
+runs=5
+rawOut=""
+while getopts "n:o:" option; do
+    case $option in
+        n) runs=$OPTARG ;;
+        o) rawOut=$OPTARG ;;
+        *) echo "Usage: $0 [-n RUNS] [-o RAW.tsv] OPEN_LNK CORPUS_DIR" >&2; exit 2 ;;
+    esac
+done
+shift $((OPTIND - 1))
+
+if [ $# -ne 2 ] || [ ! -x "$1" ] || [ ! -d "$2" ]; then
+    echo "Usage: $0 [-n RUNS] [-o RAW.tsv] OPEN_LNK CORPUS_DIR" >&2
+    exit 2
+fi
+openLnk=$(realpath "$1")
+corpus=$2
+
+# Stubs log "<what> <timestamp in µs> <argument>" and return at once
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+mkdir "$work/bin"
+for stub in xdg-open:launch notify-send:notify; do
+    cat > "$work/bin/${stub%%:*}" <<EOF
+#!/bin/bash
+echo "${stub##*:} \${EPOCHREALTIME/./} \$*" >> "$work/events"
+EOF
+    chmod +x "$work/bin/${stub%%:*}"
+done
+export PATH="$work/bin:$PATH"
+
+# Evict the files a click reads from the page cache
+dropCaches() {
+    if [ -w /proc/sys/vm/drop_caches ]; then
+        sync
+        echo 3 > /proc/sys/vm/drop_caches
+    else
+        for file in "$@"; do
+            dd if="$file" iflag=nocache count=0 status=none 2>/dev/null
+            dd of="$file" oflag=nocache conv=notrunc,fdatasync count=0 status=none 2>/dev/null
+        done
+    fi
+}
+
+# One click. Prints the latency in µs and what the stub saw, or "-" when
+# nothing was launched.
+click() {
+    : > "$work/events"
+    local start=${EPOCHREALTIME/./}
+    "$openLnk" "$1" > /dev/null 2>&1
+    local event
+    event=$(grep -m1 '^launch ' "$work/events")
+    if [ -z "$event" ]; then
+        echo "-"
+        return
+    fi
+    read -r _ launched _ <<< "$event"
+    echo "$((launched - start))"
+}
+
+# min, median, p90, p99 and max of the µs values on stdin, in ms
+summarize() {
+    sort -n | awk -v label="$1" '
+        { v[NR] = $1 }
+        END {
+            if (!NR) { printf "%-6s no launches\n", label; exit }
+            printf "%-6s n=%-5d min %8.2f  median %8.2f  p90 %8.2f  p99 %8.2f  max %8.2f ms\n", label, NR,
+                v[1] / 1000, v[int((NR + 1) / 2)] / 1000, v[int((NR * 90 + 99) / 100)] / 1000,
+                v[int((NR * 99 + 99) / 100)] / 1000, v[NR] / 1000
+        }'
+}
+
+# The stub itself costs a bash start, measured here so it can be told apart
+stubCost=""
+for _ in $(seq 20); do
+    start=${EPOCHREALTIME/./}
+    "$work/bin/xdg-open" probe
+    stubCost+="$(( $(tail -n1 "$work/events" | cut -d' ' -f2) - start ))"$'\n'
+done
+
+: > "$work/raw"
+failed=0
+while IFS= read -r -d '' lnk; do
+    for _ in $(seq "$runs"); do
+        for mode in cold warm; do
+            [ "$mode" = cold ] && dropCaches "$openLnk" "$lnk"
+            latency=$(click "$lnk")
+            if [ "$latency" = "-" ]; then
+                failed=$((failed + 1))
+            else
+                printf '%s\t%s\t%s\n' "$mode" "$latency" "$lnk" >> "$work/raw"
+            fi
+        done
+    done
+done < <(find "$corpus" -type f -iname '*.lnk' -print0 | sort -z)
+
+echo "Process start to target launch, $runs run(s) per shortcut:"
+for mode in cold warm; do
+    awk -F'\t' -v mode="$mode" '$1 == mode { print $2 }' "$work/raw" | summarize "$mode"
+done
+printf '%s' "$stubCost" | summarize "stub"
+[ "$failed" -gt 0 ] && echo "$failed click(s) launched nothing"
+[ -n "$rawOut" ] && cp "$work/raw" "$rawOut"
+exit 0
@@ -0,0 +1,204 @@
+// In-memory filesystem and generated mount table for the benchmarks. Included
+// after lnkInternal.h, it is plugged into the resolver with setResolverFs().
+
+#include <time.h>
+
+#define FAKE_TABLE_SIZE 65536
+
+// One file or directory of the fake filesystem, looked up by its full path
+typedef struct {
+    char* path;
+    int isDir;
+    long long size;
+} FakeEntry;
+
+FakeEntry fakeEntries[FAKE_TABLE_SIZE];
+
+// Open directories are handles into this list of paths. Closed handles go on a
+// free list and are reused, so the table stays as large as what is open and
+// warm runs, where the memo reopens expired directories, do not grow it. The
+// resolver calls in from a single thread here, so none of this is locked.
+char** fakeHandles = NULL;
+int* fakeFreeHandles = NULL;
+int fakeHandleCount = 0;
+int fakeFreeCount = 0;
+int fakeHandleCapacity = 0;
+
+long fakeLatencyNs = 0;
+long fakeCalls = 0;
+
+// Burn the configured latency without sleeping, sleeps are far too coarse
+void fakeDelay(void) {
+    fakeCalls++;
+    if (!fakeLatencyNs) {
+        return;
+    }
+
+    struct timespec start, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    do {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+    } while ((now.tv_sec - start.tv_sec) * 1000000000L + (now.tv_nsec - start.tv_nsec) < fakeLatencyNs);
+}
+
+FakeEntry* fakeFind(const char* path, int create) {
+    unsigned int slot = (unsigned int) hashBytes(FNV_OFFSET, path, strlen(path)) % FAKE_TABLE_SIZE;
+    while (fakeEntries[slot].path) {
+        if (strcmp(fakeEntries[slot].path, path) == 0) {
+            return &fakeEntries[slot];
+        }
+        slot = (slot + 1) % FAKE_TABLE_SIZE;
+    }
+    if (!create) {
+        return NULL;
+    }
+    fakeEntries[slot].path = strdup(path);
+    return &fakeEntries[slot];
+}
+
+void fakeAdd(const char* path, int isDir, long long size) {
+    FakeEntry* entry = fakeFind(path, 1);
+    entry->isDir = isDir;
+    entry->size = size;
+}
+
+void fakeReset(void) {
+    for (int i = 0; i < FAKE_TABLE_SIZE; i++) {
+        free(fakeEntries[i].path);
+    }
+    memset(fakeEntries, 0, sizeof(fakeEntries));
+}
+
+// Full path of name below an open fake directory
+void fakeJoin(char* out, size_t size, int dirFd, const char* name) {
+    if (dirFd == AT_FDCWD || name[0] == '/') {
+        snprintf(out, size, "%s", name);
+    } else if (strcmp(name, ".") == 0) {
+        snprintf(out, size, "%s", fakeHandles[dirFd]);
+    } else if (strcmp(fakeHandles[dirFd], "/") == 0) {
+        snprintf(out, size, "/%s", name);
+    } else {
+        snprintf(out, size, "%s/%s", fakeHandles[dirFd], name);
+    }
+}
+
+int fakeOpenDir(int dirFd, const char* path, int confine) {
+    (void) confine;
+    fakeDelay();
+
+    char full[MAX_PATH_LEN * 2];
+    fakeJoin(full, sizeof(full), dirFd, path);
+    FakeEntry* entry = fakeFind(full, 0);
+    if (!entry || !entry->isDir) {
+        errno = entry ? ENOTDIR : ENOENT;
+        return -1;
+    }
+
+    if (fakeFreeCount) {
+        int fd = fakeFreeHandles[--fakeFreeCount];
+        fakeHandles[fd] = strdup(full);
+        return fd;
+    }
+    if (fakeHandleCount == fakeHandleCapacity) {
+        fakeHandleCapacity = fakeHandleCapacity ? fakeHandleCapacity * 2 : 256;
+        fakeHandles = realloc(fakeHandles, fakeHandleCapacity * sizeof(char*));
+        fakeFreeHandles = realloc(fakeFreeHandles, fakeHandleCapacity * sizeof(int));
+    }
+    fakeHandles[fakeHandleCount] = strdup(full);
+    return fakeHandleCount++;
+}
+
+int fakeProbe(int dirFd, const char* relPath, struct stat* st, int confine) {
+    (void) confine;
+    fakeDelay();
+
+    char full[MAX_PATH_LEN * 2];
+    fakeJoin(full, sizeof(full), dirFd, relPath[0] ? relPath : ".");
+    FakeEntry* entry = fakeFind(full, 0);
+    if (!entry) {
+        errno = ENOENT;
+        return 0;
+    }
+    if (st) {
+        memset(st, 0, sizeof(*st));
+        st->st_mode = entry->isDir ? S_IFDIR | 0755 : S_IFREG | 0644;
+        st->st_size = entry->size;
+    }
+    return 1;
+}
+
+void fakeCloseDir(int fd) {
+    if (fd < 0 || fd >= fakeHandleCount || !fakeHandles[fd]) {
+        return;
+    }
+    free(fakeHandles[fd]);
+    fakeHandles[fd] = NULL;
+    fakeFreeHandles[fakeFreeCount++] = fd;
+}
+
+// Release whatever is still open, once the resolver has let go of it all
+void fakeCloseAll(void) {
+    for (int i = 0; i < fakeHandleCount; i++) {
+        free(fakeHandles[i]);
+    }
+    fakeHandleCount = 0;
+    fakeFreeCount = 0;
+}
+
+char fakeMountsPath[MAX_PATH_LEN];
+ResolverFs fakeResolverFs = {fakeMountsPath, 0, fakeOpenDir, fakeProbe, fakeCloseDir};
+
+// Write a mount table of count ext4 mounts and the matching fake tree. Only the
+// last mount holds the target, so a cold lookup has to get past every other one.
+int buildFakeMounts(const char* dir, int count) {
+    snprintf(fakeMountsPath, sizeof(fakeMountsPath), "%s/mounts", dir);
+    FILE* mounts = fopen(fakeMountsPath, "w");
+    if (!mounts) {
+        perror("Failed to write the fake mount table");
+        return 0;
+    }
+
+    fakeReset();
+    fakeAdd("/", 1, 0);
+    fakeAdd("/mnt", 1, 0);
+    for (int i = 0; i < count; i++) {
+        char mountpoint[64];
+        snprintf(mountpoint, sizeof(mountpoint), "/mnt/disk%d", i);
+        fprintf(mounts, "/dev/fake%d %s ext4 rw,relatime 0 0\n", i, mountpoint);
+        fakeAdd(mountpoint, 1, 0);
+    }
+    fclose(mounts);
+
+    char path[MAX_PATH_LEN];
+    const char* parts[] = {"/Users", "/Users/bob", "/Users/bob/Documents"};
+    for (int i = 0; i < 3; i++) {
+        snprintf(path, sizeof(path), "/mnt/disk%d%s", count - 1, parts[i]);
+        fakeAdd(path, 1, 0);
+    }
+    snprintf(path, sizeof(path), "/mnt/disk%d/Users/bob/Documents/report.pdf", count - 1);
+    fakeAdd(path, 0, 4096);
+    return 1;
+}
+
+// Forget everything learned so far: the next lookup is a cold one
+void coldStart(void) {
+    char cachePath[MAX_PATH_LEN];
+    if (driveCacheFile(cachePath, sizeof(cachePath), 0)) {
+        unlink(cachePath);
+    }
+    setResolverFs(&fakeResolverFs);
+    fakeCloseAll();
+}
+
+// Go back to the real filesystem and delete the scratch directory
+void removeFakeMounts(const char* dir) {
+    setResolverFs(&realResolverFs);
+    char cachePath[MAX_PATH_LEN];
+    if (driveCacheFile(cachePath, sizeof(cachePath), 0)) {
+        unlink(cachePath);
+        *strrchr(cachePath, '/') = '\0';
+        rmdir(cachePath);
+    }
+    unlink(fakeMountsPath);
+    rmdir(dir);
+}
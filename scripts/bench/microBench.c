@@ -0,0 +1,509 @@
+// Microbenchmarks for the reader's hot functions: binaryToASCII(), the regex
+// fallback findLongestValidPath(), the structured parser parseLnk() and
+// findMountedPath() over the fake filesystem. Inputs go from a few bytes to
+// several megabytes, plus inputs built to make the regex work hard.
+//
+// Each benchmark is warmed up, then timed over many samples on a pinned CPU.
+// Cheap calls are batched so a sample is long enough for the clock. Results
+// are min/median/p99 per call, printed and optionally written as JSON. Given a
+// baseline JSON file, medians slower than the baseline by more than the
+// threshold make the run fail.
+//
+//   gcc -O2 -pthread microBench.c ../lnkLog.c ../lnkMetrics.c ../lnkParse.c ../lnkResolve.c -o microBench
+//   ./microBench [--filter TEXT] [--cpu N] [--samples N] [--json OUT]
+//                [--baseline FILE] [--threshold PERCENT]
+
+#include "../lnkInternal.h"
+
+#include "fakeFs.c"
+
+#include <sched.h>
+
+#define MIN_SAMPLE_NS 20000.0
+#define MAX_BENCH_NS 2e9
+#define WARMUP_NS 1e8
+#define MAX_BENCHMARKS 64
+
+typedef struct {
+    const char* name;
+    void (*prepare)(size_t size);   // builds the input once, untimed
+    void (*setup)(void);            // runs before every timed call when set, untimed
+    void (*run)(void);
+    size_t size;
+} MicroBench;
+
+typedef struct {
+    const char* name;
+    size_t size;
+    int samples;
+    int batch;
+    double minNs;
+    double medianNs;
+    double p99Ns;
+} BenchResult;
+
+// Input of the benchmark being run
+unsigned char* input = NULL;
+size_t inputLength = 0;
+LnkInfo mountInfo;
+const char* mountTarget = NULL;
+char scratchDir[] = "/tmp/microBenchXXXXXX";
+
+double nowNs(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+void setInput(size_t size) {
+    free(input);
+    input = malloc(size + 1);
+    if (!input) {
+        perror("Failed to allocate the benchmark input");
+        exit(1);
+    }
+    inputLength = size;
+    input[size] = '\0';
+}
+
+// Deterministic bytes, the same input on every run and every machine
+unsigned int benchRandom(void) {
+    static unsigned int state = 0x12345678;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+void writeU16(unsigned char* p, unsigned int value) {
+    p[0] = value & 0xFF;
+    p[1] = (value >> 8) & 0xFF;
+}
+
+void writeU32(unsigned char* p, unsigned int value) {
+    writeU16(p, value & 0xFFFF);
+    writeU16(p + 2, value >> 16);
+}
+
+// Write a shortcut to C:\Users\bob\Documents\report.pdf with an IDList, a
+// LinkInfo and a relative path, then pad it with unknown ExtraData blocks
+// until it reaches size. Returns the length written.
+size_t buildLnk(unsigned char* out, size_t size) {
+    static const unsigned char linkClsid[16] = {
+        0x01, 0x14, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x46
+    };
+    const char* basePath = "C:\\Users\\bob\\Documents\\report.pdf";
+    const char* relativePath = "..\\Documents\\report.pdf";
+    size_t offset = 0;
+
+    memset(out, 0, size);
+    writeU32(out, LNK_HEADER_SIZE);
+    memcpy(out + 4, linkClsid, 16);
+    writeU32(out + 20, LNK_HAS_ID_LIST | LNK_HAS_LINK_INFO | LNK_HAS_RELATIVE_PATH | LNK_IS_UNICODE);
+    writeU32(out + 52, 4096);
+    offset = LNK_HEADER_SIZE;
+
+    // IDList: the computer root folder, then the C:\ volume
+    unsigned char* idList = out + offset + 2;
+    writeU16(idList, 20);
+    idList[2] = 0x1F;
+    writeU16(idList + 20, 25);
+    idList[22] = 0x2F;
+    memcpy(idList + 23, "C:\\", 3);
+    writeU16(idList + 45, 0);
+    writeU16(out + offset, 47);
+    offset += 2 + 47;
+
+    // LinkInfo with a VolumeID and the local base path
+    unsigned char* linkInfo = out + offset;
+    unsigned int volumeSize = 16 + 5;
+    unsigned int pathLength = (unsigned int) strlen(basePath) + 1;
+    unsigned int linkInfoSize = 0x1C + volumeSize + pathLength + 1;
+    writeU32(linkInfo, linkInfoSize);
+    writeU32(linkInfo + 4, 0x1C);
+    writeU32(linkInfo + 8, LINK_INFO_VOLUME_ID);
+    writeU32(linkInfo + 12, 0x1C);
+    writeU32(linkInfo + 16, 0x1C + volumeSize);
+    writeU32(linkInfo + 24, 0x1C + volumeSize + pathLength);
+    writeU32(linkInfo + 0x1C, volumeSize);
+    writeU32(linkInfo + 0x1C + 4, 3);
+    writeU32(linkInfo + 0x1C + 8, 0xCAFEF00D);
+    writeU32(linkInfo + 0x1C + 12, 16);
+    memcpy(linkInfo + 0x1C + 16, "DATA", 4);
+    memcpy(linkInfo + 0x1C + volumeSize, basePath, pathLength);
+    offset += linkInfoSize;
+
+    // StringData: the relative path in UTF-16
+    unsigned int count = (unsigned int) strlen(relativePath);
+    writeU16(out + offset, count);
+    for (unsigned int i = 0; i < count; i++) {
+        writeU16(out + offset + 2 + i * 2, (unsigned char) relativePath[i]);
+    }
+    offset += 2 + count * 2;
+
+    // Unknown ExtraData blocks of up to 64 KiB fill the rest
+    while (offset + 8 + 4 <= size) {
+        size_t blockSize = size - offset - 4;
+        if (blockSize > 65536) {
+            blockSize = 65536;
+        }
+        if (blockSize < 8) {
+            break;
+        }
+        writeU32(out + offset, (unsigned int) blockSize);
+        writeU32(out + offset + 4, 0xA0000099);
+        offset += blockSize;
+    }
+    writeU32(out + offset, 0);
+    return offset + 4;
+}
+
+void prepareRandomBytes(size_t size) {
+    setInput(size);
+    for (size_t i = 0; i < size; i++) {
+        input[i] = (unsigned char) benchRandom();
+    }
+}
+
+// What the regex fallback really sees: a shortcut turned into text, repeated
+void prepareLnkText(size_t size) {
+    unsigned char lnk[512];
+    size_t lnkLength = buildLnk(lnk, sizeof(lnk));
+    char* text = binaryToASCII(lnk, (int) lnkLength);
+
+    setInput(size);
+    for (size_t i = 0; i < size; i++) {
+        input[i] = (unsigned char) text[i % lnkLength];
+    }
+    free(text);
+}
+
+void preparePrintableNoise(size_t size) {
+    setInput(size);
+    for (size_t i = 0; i < size; i++) {
+        input[i] = (unsigned char) (32 + benchRandom() % 95);
+    }
+}
+
+// Worst case: one path made of thousands of space separated words, every one
+// of them a new iteration of ( [^ ]+)* to track
+void prepareSpacedWords(size_t size) {
+    setInput(size);
+    memcpy(input, "C:/a", size < 4 ? size : 4);
+    for (size_t i = 4; i < size; i++) {
+        input[i] = i % 2 ? 'b' : ' ';
+    }
+}
+
+// Worst case: a drive letter at every other byte that never becomes a path
+void prepareDriveLetters(size_t size) {
+    setInput(size);
+    for (size_t i = 0; i < size; i++) {
+        input[i] = i % 2 ? ':' : 'C';
+    }
+}
+
+// Worst case: thousands of short matches, each one a fresh regexec() call
+void prepareShortPaths(size_t size) {
+    setInput(size);
+    for (size_t i = 0; i < size; i++) {
+        input[i] = "C:/a  "[i % 6];
+    }
+}
+
+void prepareLnk(size_t size) {
+    setInput(size);
+    inputLength = buildLnk(input, size);
+}
+
+void runBinaryToASCII(void) {
+    free(binaryToASCII(input, (int) inputLength));
+}
+
+void runFindLongestValidPath(void) {
+    free(findLongestValidPath((const char*) input));
+}
+
+void runParseLnk(void) {
+    LnkInfo info;
+    parseLnk(input, (int) inputLength, &info);
+}
+
+// size is the number of mounts, only the last one holds the target
+void prepareMounts(size_t size) {
+    buildFakeMounts(scratchDir, (int) size);
+    memset(&mountInfo, 0, sizeof(mountInfo));
+    mountInfo.driveType = 3;
+    mountInfo.fileSize = 4096;
+    fakeLatencyNs = 0;
+    coldStart();
+}
+
+void prepareWarmHit(size_t size) {
+    prepareMounts(size);
+    mountTarget = "C:/Users/bob/Documents/report.pdf";
+    free(findMountedPath(mountTarget, &mountInfo, NULL));
+}
+
+void prepareWarmMiss(size_t size) {
+    prepareMounts(size);
+    mountTarget = "Q:/Users/alice/notes.txt";
+    free(findMountedPath(mountTarget, &mountInfo, NULL));
+}
+
+void prepareColdHit(size_t size) {
+    prepareMounts(size);
+    mountTarget = "C:/Users/bob/Documents/report.pdf";
+}
+
+void runFindMountedPath(void) {
+    free(findMountedPath(mountTarget, &mountInfo, NULL));
+}
+
+MicroBench benchmarks[] = {
+    {"binaryToASCII/64B", prepareRandomBytes, NULL, runBinaryToASCII, 64},
+    {"binaryToASCII/4KiB", prepareRandomBytes, NULL, runBinaryToASCII, 4096},
+    {"binaryToASCII/1MiB", prepareRandomBytes, NULL, runBinaryToASCII, 1 << 20},
+    {"binaryToASCII/8MiB", prepareRandomBytes, NULL, runBinaryToASCII, 8 << 20},
+    {"findLongestValidPath/lnk/512B", prepareLnkText, NULL, runFindLongestValidPath, 512},
+    {"findLongestValidPath/lnk/64KiB", prepareLnkText, NULL, runFindLongestValidPath, 65536},
+    {"findLongestValidPath/noise/4KiB", preparePrintableNoise, NULL, runFindLongestValidPath, 4096},
+    {"findLongestValidPath/noise/1MiB", preparePrintableNoise, NULL, runFindLongestValidPath, 1 << 20},
+    {"findLongestValidPath/spacedWords/4KiB", prepareSpacedWords, NULL, runFindLongestValidPath, 4096},
+    {"findLongestValidPath/spacedWords/64KiB", prepareSpacedWords, NULL, runFindLongestValidPath, 65536},
+    {"findLongestValidPath/driveLetters/64KiB", prepareDriveLetters, NULL, runFindLongestValidPath, 65536},
+    {"findLongestValidPath/shortPaths/64KiB", prepareShortPaths, NULL, runFindLongestValidPath, 65536},
+    {"parseLnk/small", prepareLnk, NULL, runParseLnk, 512},
+    {"parseLnk/1MiB", prepareLnk, NULL, runParseLnk, 1 << 20},
+    {"parseLnk/8MiB", prepareLnk, NULL, runParseLnk, 8 << 20},
+    {"findMountedPath/warmHit/1000", prepareWarmHit, NULL, runFindMountedPath, 1000},
+    {"findMountedPath/warmMiss/1000", prepareWarmMiss, NULL, runFindMountedPath, 1000},
+    {"findMountedPath/coldHit/10", prepareColdHit, coldStart, runFindMountedPath, 10},
+    {"findMountedPath/coldHit/1000", prepareColdHit, coldStart, runFindMountedPath, 1000},
+};
+
+int compareDoubles(const void* a, const void* b) {
+    double left = *(const double*) a;
+    double right = *(const double*) b;
+    return (left > right) - (left < right);
+}
+
+// Time one call of the benchmark, setup excluded
+double timeOnce(const MicroBench* bench) {
+    if (bench->setup) {
+        bench->setup();
+    }
+    double start = nowNs();
+    bench->run();
+    return nowNs() - start;
+}
+
+void runBenchmark(const MicroBench* bench, int maxSamples, BenchResult* result) {
+    bench->prepare(bench->size);
+
+    // Warm caches, branch predictors and the CPU clock
+    double first = timeOnce(bench);
+    double warmupStart = nowNs();
+    for (int i = 0; i < 3 || nowNs() - warmupStart < WARMUP_NS; i++) {
+        if (nowNs() - warmupStart > WARMUP_NS + 2 * first) {
+            break;
+        }
+        timeOnce(bench);
+    }
+
+    // Batch cheap calls so each sample is well above the clock resolution.
+    // Calls with a setup step cannot be batched.
+    double estimate = timeOnce(bench);
+    int batch = 1;
+    if (!bench->setup && estimate < MIN_SAMPLE_NS) {
+        batch = (int) (MIN_SAMPLE_NS / (estimate > 1 ? estimate : 1)) + 1;
+    }
+
+    // Slow benchmarks take fewer samples, but never less than 11
+    int samples = maxSamples;
+    if (estimate * batch * samples > MAX_BENCH_NS) {
+        samples = (int) (MAX_BENCH_NS / (estimate * batch));
+    }
+    if (samples < 11) {
+        samples = 11;
+    }
+
+    double* times = malloc(samples * sizeof(double));
+    for (int s = 0; s < samples; s++) {
+        if (batch == 1) {
+            times[s] = timeOnce(bench);
+            continue;
+        }
+        double start = nowNs();
+        for (int b = 0; b < batch; b++) {
+            bench->run();
+        }
+        times[s] = (nowNs() - start) / batch;
+    }
+    qsort(times, samples, sizeof(double), compareDoubles);
+
+    result->name = bench->name;
+    result->size = bench->size;
+    result->samples = samples;
+    result->batch = batch;
+    result->minNs = times[0];
+    result->medianNs = times[samples / 2];
+    result->p99Ns = times[(samples * 99 + 99) / 100 - 1];
+    free(times);
+}
+
+void writeResultJson(FILE* out, const BenchResult* result) {
+    fprintf(out, "{\"name\":\"%s\",\"size\":%zu,\"samples\":%d,\"batch\":%d,\"min_ns\":%.1f,\"median_ns\":%.1f,\"p99_ns\":%.1f}",
+            result->name, result->size, result->samples, result->batch, result->minNs, result->medianNs, result->p99Ns);
+}
+
+int writeResultsJson(const char* path, int cpu, const BenchResult* results, int count) {
+    FILE* out = fopen(path, "w");
+    if (!out) {
+        perror("Failed to write the results");
+        return 0;
+    }
+
+    fprintf(out, "{\"cpu\":%d,\"benchmarks\":[\n", cpu);
+    for (int i = 0; i < count; i++) {
+        fputs("  ", out);
+        writeResultJson(out, &results[i]);
+        fputs(i + 1 < count ? ",\n" : "\n", out);
+    }
+    fputs("]}\n", out);
+    return fclose(out) == 0;
+}
+
+// Median of a benchmark in a results file written by writeResultsJson(), one
+// benchmark per line. Returns a negative value when it is not there.
+double baselineMedian(const char* baseline, const char* name) {
+    char key[256];
+    snprintf(key, sizeof(key), "\"name\":\"%s\"", name);
+
+    const char* line = strstr(baseline, key);
+    if (!line) {
+        return -1;
+    }
+    const char* median = strstr(line, "\"median_ns\":");
+    const char* end = strchr(line, '\n');
+    if (!median || (end && median > end)) {
+        return -1;
+    }
+    return strtod(median + strlen("\"median_ns\":"), NULL);
+}
+
+char* readWholeFile(const char* path) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        perror("Failed to open the baseline");
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char* text = malloc(length + 1);
+    if (text) {
+        text[fread(text, 1, length, file)] = '\0';
+    }
+    fclose(file);
+    return text;
+}
+
+// Pin to one CPU so the scheduler does not move samples across cores
+int pinCpu(int cpu) {
+    if (cpu < 0) {
+        cpu = sched_getcpu();
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+        perror("Failed to pin the benchmark to a CPU");
+        return -1;
+    }
+    return cpu;
+}
+
+int main(int argc, char* argv[]) {
+    const char* filter = NULL;
+    const char* jsonPath = NULL;
+    const char* baselinePath = NULL;
+    double threshold = 10;
+    int cpu = -1;
+    int maxSamples = 201;
+
+    for (int i = 1; i < argc; i++) {
+        int hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--filter") == 0 && hasValue) {
+            filter = argv[++i];
+        } else if (strcmp(argv[i], "--json") == 0 && hasValue) {
+            jsonPath = argv[++i];
+        } else if (strcmp(argv[i], "--baseline") == 0 && hasValue) {
+            baselinePath = argv[++i];
+        } else if (strcmp(argv[i], "--threshold") == 0 && hasValue) {
+            threshold = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--cpu") == 0 && hasValue) {
+            cpu = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--samples") == 0 && hasValue) {
+            maxSamples = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--filter TEXT] [--cpu N] [--samples N] [--json OUT] [--baseline FILE] [--threshold PERCENT]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (maxSamples < 11) {
+        maxSamples = 11;
+    }
+
+    char* baseline = NULL;
+    if (baselinePath && !(baseline = readWholeFile(baselinePath))) {
+        return 2;
+    }
+
+    // The mount benchmarks keep their learned drive table in a scratch directory
+    if (!mkdtemp(scratchDir)) {
+        perror("Failed to create a scratch directory");
+        return 2;
+    }
+    setenv("XDG_CACHE_HOME", scratchDir, 1);
+    logLevel = LOG_OFF;
+    cpu = pinCpu(cpu);
+
+    BenchResult results[MAX_BENCHMARKS];
+    int count = 0;
+    int regressions = 0;
+    printf("%-42s %12s %12s %12s %8s\n", "benchmark", "min ns", "median ns", "p99 ns", "samples");
+
+    for (int i = 0; i < (int) (sizeof(benchmarks) / sizeof(benchmarks[0])); i++) {
+        if (filter && !strstr(benchmarks[i].name, filter)) {
+            continue;
+        }
+
+        BenchResult* result = &results[count++];
+        runBenchmark(&benchmarks[i], maxSamples, result);
+        printf("%-42s %12.1f %12.1f %12.1f %8d", result->name, result->minNs, result->medianNs, result->p99Ns, result->samples);
+
+        double reference = baseline ? baselineMedian(baseline, result->name) : -1;
+        if (reference > 0) {
+            double change = (result->medianNs - reference) * 100 / reference;
+            int regressed = change > threshold;
+            regressions += regressed;
+            printf("  %+6.1f%%%s", change, regressed ? "  REGRESSION" : "");
+        }
+        putchar('\n');
+    }
+
+    free(input);
+    free(baseline);
+    removeFakeMounts(scratchDir);
+
+    if (jsonPath && !writeResultsJson(jsonPath, cpu, results, count)) {
+        return 2;
+    }
+    if (regressions) {
+        fprintf(stderr, "%d benchmark(s) slower than the baseline by more than %.1f%%\n", regressions, threshold);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,174 @@
+// Allocation statistics, compiled in with -DLNK_ALLOC_STATS
+
+#include "lnkInternal.h"
+
+
+/*
+____ _    _    ____ ____ 
+|__| |    |    |  | |    
+|  | |___ |___ |__| |___ 
+
+*/
+
+// Built with -DLNK_ALLOC_STATS, malloc and friends are replaced by wrappers that
+// count what every run and every shortcut allocates. glibc routes its own
+// allocations (strdup, fopen, regcomp...) through them as well.
+#ifdef LNK_ALLOC_STATS
+#include <malloc.h>
+
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void* __libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void* ptr);
+
+atomic_long allocCount = 0;
+atomic_long allocBytes = 0;
+atomic_long allocLive = 0;
+atomic_long allocPeakLive = 0;
+
+// Set once a bulk run reaches steady state: any allocation after that aborts,
+// leaving a core with the offending stack
+atomic_int allocSteady = 0;
+int allocWarmupFiles = -1;
+
+void checkSteadyState(void) {
+    if (atomic_load(&allocSteady)) {
+        static const char message[] = "Allocation in steady state, aborting\n";
+        write(STDERR_FILENO, message, sizeof(message) - 1);
+        abort();
+    }
+}
+
+void countAllocation(void* ptr) {
+    if (!ptr) {
+        return;
+    }
+    long size = (long) malloc_usable_size(ptr);
+    atomic_fetch_add(&allocCount, 1);
+    atomic_fetch_add(&allocBytes, size);
+
+    long live = atomic_fetch_add(&allocLive, size) + size;
+    long peak = atomic_load(&allocPeakLive);
+    while (live > peak && !atomic_compare_exchange_weak(&allocPeakLive, &peak, live)) {
+    }
+}
+
+void countRelease(void* ptr) {
+    if (ptr) {
+        atomic_fetch_sub(&allocLive, (long) malloc_usable_size(ptr));
+    }
+}
+
+void* malloc(size_t size) {
+    checkSteadyState();
+    void* ptr = __libc_malloc(size);
+    countAllocation(ptr);
+    return ptr;
+}
+
+void* calloc(size_t count, size_t size) {
+    checkSteadyState();
+    void* ptr = __libc_calloc(count, size);
+    countAllocation(ptr);
+    return ptr;
+}
+
+// Counted as a release of the old block and an allocation of the new one
+void* realloc(void* ptr, size_t size) {
+    if (size) {
+        checkSteadyState();
+    }
+    long oldSize = ptr ? (long) malloc_usable_size(ptr) : 0;
+    void* moved = __libc_realloc(ptr, size);
+    if (moved || !size) {
+        atomic_fetch_sub(&allocLive, oldSize);
+        countAllocation(moved);
+    }
+    return moved;
+}
+
+void* memalign(size_t alignment, size_t size) {
+    checkSteadyState();
+    void* ptr = __libc_memalign(alignment, size);
+    countAllocation(ptr);
+    return ptr;
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+    return memalign(alignment, size);
+}
+
+int posix_memalign(void** out, size_t alignment, size_t size) {
+    void* ptr = memalign(alignment, size);
+    if (!ptr) {
+        return ENOMEM;
+    }
+    *out = ptr;
+    return 0;
+}
+
+void free(void* ptr) {
+    countRelease(ptr);
+    __libc_free(ptr);
+}
+
+// Peak resident set size in KiB. Read with plain syscalls, stdio would allocate.
+long readPeakRss(void) {
+    char status[4096];
+    int fd = open("/proc/self/status", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    ssize_t length = read(fd, status, sizeof(status) - 1);
+    close(fd);
+    if (length <= 0) {
+        return -1;
+    }
+    status[length] = '\0';
+
+    const char* peak = strstr(status, "VmHWM:");
+    return peak ? strtol(peak + 6, NULL, 10) : -1;
+}
+
+// Start measuring the peak RSS again from the current RSS
+void resetPeakRss(void) {
+    int fd = open("/proc/self/clear_refs", O_WRONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        write(fd, "5", 1);
+        close(fd);
+    }
+}
+
+long runPeakLive = 0;
+long runPeakRss = 0;
+
+void beginAllocFile(AllocMark* mark) {
+    mark->count = atomic_load(&allocCount);
+    mark->bytes = atomic_load(&allocBytes);
+    atomic_store(&allocPeakLive, atomic_load(&allocLive));
+    resetPeakRss();
+}
+
+// Append this shortcut's figures to its JSON record
+void endAllocFile(const AllocMark* mark, FILE* out) {
+    long peakLive = atomic_load(&allocPeakLive);
+    long peakRss = readPeakRss();
+    runPeakLive = peakLive > runPeakLive ? peakLive : runPeakLive;
+    runPeakRss = peakRss > runPeakRss ? peakRss : runPeakRss;
+
+    fprintf(out, ",\"allocs\":%ld,\"alloc_bytes\":%ld,\"peak_heap\":%ld,\"peak_rss_kb\":%ld",
+            atomic_load(&allocCount) - mark->count, atomic_load(&allocBytes) - mark->bytes, peakLive, peakRss);
+}
+
+// Totals for the whole run, on stderr so bulk output stays NDJSON
+void printAllocSummary(void) {
+    long peakLive = atomic_load(&allocPeakLive);
+    long peakRss = readPeakRss();
+    runPeakLive = peakLive > runPeakLive ? peakLive : runPeakLive;
+    runPeakRss = peakRss > runPeakRss ? peakRss : runPeakRss;
+
+    fprintf(stderr, "allocations: %ld, bytes: %ld, live at exit: %ld, peak heap: %ld, peak RSS: %ld KiB\n",
+            atomic_load(&allocCount), atomic_load(&allocBytes), atomic_load(&allocLive), runPeakLive, runPeakRss);
+}
+#endif
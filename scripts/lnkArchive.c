@@ -0,0 +1,272 @@
+// --archive: the shortcuts inside tar and cpio streams
+
+#include "lnkInternal.h"
+
+
+/*
+____ ____ ____ _  _ _ _  _ ____ ____ 
+|__| |__/ |    |__| | |  | |___ [__  
+|  | |  \ |___ |  | |  \/  |___ ___] 
+
+*/
+
+// --archive reads a tar or cpio stream and resolves its .lnk members as they go
+// by, extracting nothing. Other members are skipped, with a seek when the input
+// is a file and by reading past them when it is a pipe.
+#define TAR_BLOCK 512
+#define PAX_MAX_SIZE 65536
+
+typedef struct {
+    FILE* file;
+    int seekable;
+} ArchiveStream;
+
+int readArchive(ArchiveStream* stream, void* buffer, size_t size) {
+    return fread(buffer, 1, size, stream->file) == size;
+}
+
+// Move past size bytes of the stream
+int skipArchive(ArchiveStream* stream, unsigned long long size) {
+    if (stream->seekable && size > TAR_BLOCK) {
+        return fseeko(stream->file, (off_t) size, SEEK_CUR) == 0;
+    }
+    char buffer[16384];
+    while (size) {
+        size_t chunk = size < sizeof(buffer) ? size : sizeof(buffer);
+        if (fread(buffer, 1, chunk, stream->file) != chunk) {
+            return 0;
+        }
+        size -= chunk;
+    }
+    return 1;
+}
+
+// Read a member of size bytes followed by padding bytes. A .lnk member is
+// resolved from its first MAX_DATA_SIZE bytes, anything else is skipped.
+int readArchiveMember(ArchiveStream* stream, const char* name, unsigned long long size, unsigned int padding) {
+    if (!hasLnkExtension(name) || !inShard(name)) {
+        return skipArchive(stream, size + padding);
+    }
+
+    long long start = monotonicMicros();
+    unsigned char data[MAX_DATA_SIZE];
+    size_t length = size < sizeof(data) ? size : sizeof(data);
+    if (!readArchive(stream, data, length) || !skipArchive(stream, size - length + padding)) {
+        return 0;
+    }
+    char* targetPath;
+    LnkInfo info;
+    memset(&info, 0, sizeof(info));
+    // The member name is a path inside the archive, not on this machine: no
+    // relative target is looked for from it
+    int result = resolveLnkData("", data, (int) length, &targetPath, &info, start);
+    writeResolvedRecord(name, result, targetPath);
+    fputs("}\n", stdout);
+    free(targetPath);
+    return 1;
+}
+
+// A numeric tar field: octal text, or base-256 when its first bit is set
+unsigned long long tarNumber(const unsigned char* field, int size) {
+    unsigned long long value = 0;
+    if (field[0] & 0x80) {
+        for (int i = 1; i < size; i++) {
+            value = value << 8 | field[i];
+        }
+        return value;
+    }
+    for (int i = 0; i < size && field[i]; i++) {
+        if (field[i] >= '0' && field[i] <= '7') {
+            value = value * 8 + (field[i] - '0');
+        }
+    }
+    return value;
+}
+
+// The header checksum counts its own field as spaces
+int tarChecksumValid(const unsigned char* header) {
+    unsigned long long sum = 0;
+    for (int i = 0; i < TAR_BLOCK; i++) {
+        sum += i >= 148 && i < 156 ? ' ' : header[i];
+    }
+    return sum == tarNumber(header + 148, 8);
+}
+
+// Apply the path and size records of a pax extended header ("LEN key=value\n")
+void parsePaxHeader(char* pax, size_t size, char* name, int nameSize, unsigned long long* memberSize) {
+    size_t offset = 0;
+    while (offset < size) {
+        char* end;
+        unsigned long length = strtoul(pax + offset, &end, 10);
+        char* key = end + 1;
+        if (*end != ' ' || length < 5 || length > size - offset) {
+            return;
+        }
+        char* value = memchr(key, '=', pax + offset + length - key);
+        if (value) {
+            *value++ = '\0';
+            pax[offset + length - 1] = '\0';
+            if (strcmp(key, "path") == 0) {
+                snprintf(name, nameSize, "%s", value);
+            } else if (strcmp(key, "size") == 0) {
+                *memberSize = strtoull(value, NULL, 10);
+            }
+        }
+        offset += length;
+    }
+}
+
+// ustar, GNU and pax tar. header holds the first block, already read.
+int readTar(ArchiveStream* stream, unsigned char* header) {
+    static char name[PATH_MAX], nextName[PATH_MAX];
+    static char pax[PAX_MAX_SIZE + 1];
+    unsigned long long nextSize = 0;
+    int hasNextSize = 0;
+    nextName[0] = '\0';
+
+    for (;;) {
+        // The archive ends with zero blocks
+        if (header[0] == '\0') {
+            return 1;
+        }
+        if (!tarChecksumValid(header)) {
+            fprintf(stderr, "Bad tar header checksum\n");
+            return 0;
+        }
+
+        unsigned long long size = tarNumber(header + 124, 12);
+        unsigned int padding = (TAR_BLOCK - size % TAR_BLOCK) % TAR_BLOCK;
+        char type = (char) header[156];
+
+        if (type == 'L' || type == 'x') {
+            // Long name or extended header, for the member that follows
+            size_t length = size < PAX_MAX_SIZE ? size : PAX_MAX_SIZE;
+            if (!readArchive(stream, pax, length) || !skipArchive(stream, size - length + padding)) {
+                return 0;
+            }
+            pax[length] = '\0';
+            if (type == 'L') {
+                snprintf(nextName, sizeof(nextName), "%.*s", (int) sizeof(nextName) - 1, pax);
+            } else {
+                unsigned long long paxSize = ULLONG_MAX;
+                parsePaxHeader(pax, length, nextName, sizeof(nextName), &paxSize);
+                if (paxSize != ULLONG_MAX) {
+                    nextSize = paxSize;
+                    hasNextSize = 1;
+                }
+            }
+        } else if (type == 'K' || type == 'g') {
+            // Long link names and global headers say nothing about shortcuts
+            if (!skipArchive(stream, size + padding)) {
+                return 0;
+            }
+        } else {
+            if (nextName[0]) {
+                snprintf(name, sizeof(name), "%s", nextName);
+            } else if (memcmp(header + 257, "ustar", 5) == 0 && header[345]) {
+                snprintf(name, sizeof(name), "%.155s/%.100s", header + 345, header);
+            } else {
+                snprintf(name, sizeof(name), "%.100s", header);
+            }
+            if (hasNextSize) {
+                size = nextSize;
+                padding = (TAR_BLOCK - size % TAR_BLOCK) % TAR_BLOCK;
+            }
+            nextName[0] = '\0';
+            hasNextSize = 0;
+
+            // Regular files only, directories and links carry no shortcut
+            int regular = type == '0' || type == '\0' || type == '7';
+            if (!(regular ? readArchiveMember(stream, name, size, padding) : skipArchive(stream, size + padding))) {
+                return 0;
+            }
+        }
+
+        if (!readArchive(stream, header, TAR_BLOCK)) {
+            return 1;   // Archives cut short of their end blocks are common
+        }
+    }
+}
+
+// Parse a fixed width number of a cpio header
+unsigned long long cpioNumber(const unsigned char* field, int size, int base) {
+    char text[16];
+    memcpy(text, field, size);
+    text[size] = '\0';
+    return strtoull(text, NULL, base);
+}
+
+// newc ("070701", "070702") and odc ("070707") cpio. magic holds the first 6 bytes.
+int readCpio(ArchiveStream* stream, unsigned char* magic) {
+    static char name[PATH_MAX];
+    unsigned char header[110];
+    memcpy(header, magic, 6);
+
+    for (;;) {
+        int newc = memcmp(header, "07070", 5) == 0 && (header[5] == '1' || header[5] == '2');
+        if (!newc && memcmp(header, "070707", 6) != 0) {
+            fprintf(stderr, "Bad cpio header\n");
+            return 0;
+        }
+
+        // newc: 13 fields of 8 hex digits. odc: octal fields of 6 and 11 digits.
+        int headerSize = newc ? 110 : 76;
+        if (!readArchive(stream, header + 6, headerSize - 6)) {
+            return 0;
+        }
+        unsigned long long mode = newc ? cpioNumber(header + 14, 8, 16) : cpioNumber(header + 18, 6, 8);
+        unsigned long long nameSize = newc ? cpioNumber(header + 94, 8, 16) : cpioNumber(header + 59, 6, 8);
+        unsigned long long size = newc ? cpioNumber(header + 54, 8, 16) : cpioNumber(header + 65, 11, 8);
+
+        // newc pads the name and the data to 4 bytes
+        unsigned int namePadding = newc ? (4 - (headerSize + nameSize) % 4) % 4 : 0;
+        unsigned int dataPadding = newc ? (4 - size % 4) % 4 : 0;
+        size_t kept = nameSize < sizeof(name) ? nameSize : sizeof(name) - 1;
+        if (!nameSize || !readArchive(stream, name, kept) || !skipArchive(stream, nameSize - kept + namePadding)) {
+            return 0;
+        }
+        name[kept] = '\0';
+        if (strcmp(name, "TRAILER!!!") == 0) {
+            return 1;
+        }
+
+        int regular = (mode & 0170000) == 0100000;
+        if (!(regular ? readArchiveMember(stream, name, size, dataPadding) : skipArchive(stream, size + dataPadding))) {
+            return 0;
+        }
+        if (!readArchive(stream, header, 6)) {
+            return 1;
+        }
+    }
+}
+
+// --archive FILE: resolve every .lnk member of a tar or cpio archive, "-" for stdin
+int resolveArchive(const char* path) {
+    ArchiveStream stream;
+    stream.file = strcmp(path, "-") == 0 ? stdin : fopen(path, "rb");
+    if (!stream.file) {
+        perror(path);
+        return 1;
+    }
+    struct stat st;
+    stream.seekable = fstat(fileno(stream.file), &st) == 0 && S_ISREG(st.st_mode);
+
+    // cpio starts with its magic, tar has "ustar" at 257 or a valid checksum
+    unsigned char header[TAR_BLOCK];
+    int ok;
+    if (!readArchive(&stream, header, 6)) {
+        ok = 0;
+    } else if (memcmp(header, "07070", 5) == 0) {
+        ok = readCpio(&stream, header);
+    } else {
+        ok = readArchive(&stream, header + 6, TAR_BLOCK - 6) && tarChecksumValid(header) && readTar(&stream, header);
+    }
+    if (!ok) {
+        fprintf(stderr, "%s: not a tar or cpio archive, or cut short\n", path);
+    }
+
+    if (stream.file != stdin) {
+        fclose(stream.file);
+    }
+    return !ok;
+}
@@ -0,0 +1,239 @@
+// --carve: shortcuts inside disk images, memory dumps and pagefiles
+
+#include "lnkInternal.h"
+
+// --carve looks for shortcut headers 16 bytes at a time where SSE2 is there
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+/*
+____ ____ ____ _  _ ____ 
+|    |__| |__/ |  | |___ 
+|___ |  | |  \  \/  |___ 
+
+*/
+
+#define CARVE_CHUNK (16 << 20)
+#define CARVE_MAX_LNK 65536
+
+// --carve finds shortcuts inside anything: disk images, memory dumps, pagefiles.
+// The file is mapped and cut into CARVE_CHUNK chunks that threads take in turn.
+// A hit belongs to the chunk it starts in, and is read past the end of it when
+// it straddles two, so chunks need no overlap of their own.
+typedef struct {
+    const unsigned char* data;
+    size_t size;
+    size_t chunkCount;
+    atomic_size_t nextChunk;
+    atomic_long hits;
+    pthread_mutex_t lock;           // Guards what follows
+    char** outputs;                 // Records of finished chunks not printed yet
+    size_t* outputSizes;
+    unsigned char* finished;
+    size_t nextPrinted;
+} CarveJob;
+
+// Offset of the first header signature starting in [from, end), or end. The
+// signature is the header size and the start of the CLSID: 4C 00 00 00 01 14 02 00.
+size_t findLnkSignature(const unsigned char* data, size_t size, size_t from, size_t end) {
+    static const unsigned char signature[8] = {0x4C, 0x00, 0x00, 0x00, 0x01, 0x14, 0x02, 0x00};
+    size_t at = from;
+#ifdef __SSE2__
+    // 0x4C four bytes before 0x01 is rare enough to check the rest one by one
+    const __m128i first = _mm_set1_epi8(0x4C);
+    const __m128i fifth = _mm_set1_epi8(0x01);
+    for (; at < end && at + 20 <= size; at += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i*) (data + at));
+        __m128i b = _mm_loadu_si128((const __m128i*) (data + at + 4));
+        unsigned int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, fifth)));
+        for (; mask; mask &= mask - 1) {
+            size_t hit = at + __builtin_ctz(mask);
+            if (hit >= end) {
+                return end;
+            }
+            if (memcmp(data + hit, signature, sizeof(signature)) == 0) {
+                return hit;
+            }
+        }
+    }
+#else
+    size_t limit = end + sizeof(signature) - 1 < size ? end + sizeof(signature) - 1 : size;
+    const unsigned char* hit = at < limit ? memmem(data + at, limit - at, signature, sizeof(signature)) : NULL;
+    at = hit ? (size_t) (hit - data) : end;
+#endif
+    for (; at < end && at + sizeof(signature) <= size; at++) {
+        if (memcmp(data + at, signature, sizeof(signature)) == 0) {
+            return at;
+        }
+    }
+    return end;
+}
+
+// The ,"target":... fields of a record about a shortcut that is not resolved here
+void writeRecordedTarget(FILE* out, const LnkInfo* info, const char* target) {
+    fputs(",\"target\":", out);
+    writeJsonString(out, target);
+    if (info->netName[0]) {
+        fputs(",\"share\":", out);
+        writeJsonString(out, info->netName);
+    }
+    if (info->volumeLabel[0]) {
+        fputs(",\"volume_label\":", out);
+        writeJsonString(out, info->volumeLabel);
+    }
+    if (info->driveSerial) {
+        fprintf(out, ",\"volume_serial\":\"%08X\"", info->driveSerial);
+    }
+    if (info->writeTime) {
+        fprintf(out, ",\"target_mtime\":%lld", filetimeToUnix(info->writeTime));
+    }
+    fprintf(out, ",\"target_size\":%u", info->fileSize);
+}
+
+// Parse the shortcut at offset in place and write its record. Returns 0 for a
+// false hit: reserved header fields set, or no path of any kind.
+int carveRecord(const unsigned char* data, size_t size, size_t offset, FILE* out) {
+    const unsigned char* lnk = data + offset;
+    size_t length = size - offset < CARVE_MAX_LNK ? size - offset : CARVE_MAX_LNK;
+    LnkInfo info;
+    if (length < LNK_HEADER_SIZE || readU16(lnk + 66) || readU32(lnk + 68) || readU32(lnk + 72)
+        || !parseLnk(lnk, (int) length, &info)) {
+        return 0;
+    }
+    char* target = recordedTarget(&info);
+    if (!target) {
+        return 0;
+    }
+
+    fprintf(out, "{\"offset\":%zu", offset);
+    writeRecordedTarget(out, &info, target);
+    fputs("}\n", out);
+    free(target);
+    return 1;
+}
+
+// Carve chunks until there are none left. Records of each chunk are kept until
+// every chunk before it is printed, so the output is in offset order.
+void* carveThread(void* arg) {
+    CarveJob* job = arg;
+    size_t chunk;
+    while ((chunk = atomic_fetch_add(&job->nextChunk, 1)) < job->chunkCount) {
+        size_t start = chunk * (size_t) CARVE_CHUNK;
+        size_t end = start + CARVE_CHUNK < job->size ? start + CARVE_CHUNK : job->size;
+
+        char* buffer = NULL;
+        size_t length = 0;
+        FILE* out = open_memstream(&buffer, &length);
+        if (!out) {
+            perror("Failed to buffer carved records");
+        }
+        for (size_t at = start; out && (at = findLnkSignature(job->data, job->size, at, end)) < end; at++) {
+            if (carveRecord(job->data, job->size, at, out)) {
+                atomic_fetch_add(&job->hits, 1);
+            }
+        }
+        if (out) {
+            fclose(out);
+        }
+
+        pthread_mutex_lock(&job->lock);
+        job->outputs[chunk] = buffer;
+        job->outputSizes[chunk] = length;
+        job->finished[chunk] = 1;
+        while (job->nextPrinted < job->chunkCount && job->finished[job->nextPrinted]) {
+            fwrite(job->outputs[job->nextPrinted], 1, job->outputSizes[job->nextPrinted], stdout);
+            free(job->outputs[job->nextPrinted]);
+            job->nextPrinted++;
+        }
+        pthread_mutex_unlock(&job->lock);
+    }
+    return NULL;
+}
+
+// Map a file or block device read-only. Returns 0 on failure; an empty file
+// maps to NULL. Pages are only read once touched.
+int mapFile(const char* path, const unsigned char** data, size_t* size) {
+    *data = NULL;
+    *size = 0;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        perror(path);
+        return 0;
+    }
+    // Block devices have no st_size, seeking to the end tells their size
+    off_t end = lseek(fd, 0, SEEK_END);
+    if (end <= 0) {
+        if (end < 0) {
+            perror(path);
+        }
+        close(fd);
+        return end == 0;
+    }
+    void* mapped = mmap(NULL, end, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        perror("Failed to map the file");
+        return 0;
+    }
+    *data = mapped;
+    *size = end;
+    return 1;
+}
+
+// --carve FILE: one JSON line per shortcut found anywhere in a file or block device
+int carveFile(const char* path) {
+    const unsigned char* data;
+    size_t size;
+    if (!mapFile(path, &data, &size)) {
+        return 1;
+    }
+    if (!data) {
+        return 0;
+    }
+    madvise((void*) data, size, MADV_SEQUENTIAL);
+
+    CarveJob job;
+    memset(&job, 0, sizeof(job));
+    job.data = data;
+    job.size = size;
+    job.chunkCount = (size + CARVE_CHUNK - 1) / CARVE_CHUNK;
+    job.outputs = calloc(job.chunkCount, sizeof(char*));
+    job.outputSizes = calloc(job.chunkCount, sizeof(size_t));
+    job.finished = calloc(job.chunkCount, 1);
+    pthread_mutex_init(&job.lock, NULL);
+    if (!job.outputs || !job.outputSizes || !job.finished) {
+        perror("Failed to allocate the carve chunks");
+        munmap((void*) data, size);
+        return 1;
+    }
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int threadCount = cpus < 1 ? 1 : cpus > 64 ? 64 : (int) cpus;
+    if ((size_t) threadCount > job.chunkCount) {
+        threadCount = (int) job.chunkCount;
+    }
+    pthread_t threads[64];
+    int started = 0;
+    for (; started < threadCount; started++) {
+        if (pthread_create(&threads[started], NULL, carveThread, &job) != 0) {
+            break;
+        }
+    }
+    // Without threads the work is done here
+    if (!started) {
+        carveThread(&job);
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    LOG(LOG_INFO, "%ld shortcuts carved from %s\n", atomic_load(&job.hits), path);
+
+    pthread_mutex_destroy(&job.lock);
+    free(job.outputs);
+    free(job.outputSizes);
+    free(job.finished);
+    munmap((void*) data, size);
+    return 0;
+}
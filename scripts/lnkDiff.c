@@ -0,0 +1,312 @@
+// --diff: the shortcuts whose target changed between two outputs
+
+#include "lnkInternal.h"
+
+
+/*
+___  _ ____ ____ 
+|  \ | |___ |___ 
+|__/ | |    |    
+
+*/
+
+// --diff joins two outputs on the shortcut path, which needs both sorted. An
+// output that is not, or that can not be read twice, is sorted on disk first:
+// chunks of SORT_CHUNK bytes are sorted in memory and written out as runs, and
+// every SORT_FAN_IN runs of one level are merged into one run of the next.
+// Memory stays at one chunk whatever the size of the input.
+#define SORT_CHUNK (64 << 20)
+#define SORT_FAN_IN 16
+#define SORT_LEVELS 8            // 16^8 chunks, more than any disk holds
+
+typedef struct {
+    const char* key;
+    const char* line;
+} SortRecord;
+
+typedef struct {
+    FILE* runs[SORT_LEVELS][SORT_FAN_IN];
+    int runCount[SORT_LEVELS];
+    char* arena;            // Lines and their keys, SORT_CHUNK bytes
+    size_t used;
+    SortRecord* records;
+    int recordCount;
+    int recordCapacity;
+} ExternalSort;
+
+int compareSortRecords(const void* a, const void* b) {
+    return strcmp(((const SortRecord*) a)->key, ((const SortRecord*) b)->key);
+}
+
+// An anonymous file in $TMPDIR, gone once closed
+FILE* openTempFile(void) {
+    const char* dir = getenv("TMPDIR");
+    char path[MAX_PATH_LEN];
+    snprintf(path, sizeof(path), "%s/open_lnk.sort.XXXXXX", dir && dir[0] ? dir : "/tmp");
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        perror("Failed to create a sort run");
+        return NULL;
+    }
+    unlink(path);
+    FILE* file = fdopen(fd, "w+");
+    if (!file) {
+        perror("Failed to create a sort run");
+        close(fd);
+    }
+    return file;
+}
+
+// Merge sorted runs into a new one, closing them. Returns NULL on failure.
+FILE* mergeRuns(FILE** runs, int count) {
+    FILE* out = openTempFile();
+    MergeInput* inputs = calloc(count, sizeof(MergeInput));
+    int merged = out && inputs;
+    for (int i = 0; merged && i < count; i++) {
+        rewind(runs[i]);
+        inputs[i].file = runs[i];
+    }
+    merged = merged && mergeInputs(inputs, count, out) && fflush(out) == 0;
+
+    for (int i = 0; i < count; i++) {
+        fclose(runs[i]);
+        if (inputs) {
+            free(inputs[i].line);
+        }
+    }
+    free(inputs);
+    if (!merged && out) {
+        fclose(out);
+        out = NULL;
+    }
+    return out;
+}
+
+// Add a sorted run at level 0. A level that fills up is merged into one run of
+// the next, so every record is rewritten once per level.
+int addSortRun(ExternalSort* sort, FILE* run) {
+    int level = 0;
+    sort->runs[level][sort->runCount[level]++] = run;
+    while (sort->runCount[level] == SORT_FAN_IN) {
+        if (level == SORT_LEVELS - 1) {
+            fprintf(stderr, "Too many sort runs\n");
+            return 0;
+        }
+        run = mergeRuns(sort->runs[level], SORT_FAN_IN);
+        sort->runCount[level] = 0;
+        if (!run) {
+            return 0;
+        }
+        level++;
+        sort->runs[level][sort->runCount[level]++] = run;
+    }
+    return 1;
+}
+
+// Sort the records of the chunk and write them out as a run
+int flushSortChunk(ExternalSort* sort) {
+    if (!sort->recordCount) {
+        return 1;
+    }
+    qsort(sort->records, sort->recordCount, sizeof(SortRecord), compareSortRecords);
+    FILE* run = openTempFile();
+    if (!run) {
+        return 0;
+    }
+    for (int i = 0; i < sort->recordCount; i++) {
+        fputs(sort->records[i].line, run);
+    }
+    if (fflush(run) != 0) {
+        perror("Failed to write a sort run");
+        fclose(run);
+        return 0;
+    }
+    sort->used = 0;
+    sort->recordCount = 0;
+    return addSortRun(sort, run);
+}
+
+// Add one line and its path to the chunk
+int addSortRecord(ExternalSort* sort, const char* line, const char* key) {
+    size_t lineSize = strlen(line) + 1;
+    size_t keySize = strlen(key) + 1;
+    if (lineSize + keySize > SORT_CHUNK) {
+        fprintf(stderr, "Record too long to sort: %s\n", key);
+        return 0;
+    }
+    if (sort->used + lineSize + keySize > SORT_CHUNK && !flushSortChunk(sort)) {
+        return 0;
+    }
+    if (sort->recordCount == sort->recordCapacity) {
+        int capacity = sort->recordCapacity ? sort->recordCapacity * 2 : 4096;
+        SortRecord* records = realloc(sort->records, capacity * sizeof(SortRecord));
+        if (!records) {
+            perror("Failed to allocate the sort records");
+            return 0;
+        }
+        sort->records = records;
+        sort->recordCapacity = capacity;
+    }
+
+    char* copy = sort->arena + sort->used;
+    memcpy(copy, line, lineSize);
+    memcpy(copy + lineSize, key, keySize);
+    sort->used += lineSize + keySize;
+    sort->records[sort->recordCount++] = (SortRecord) {copy + lineSize, copy};
+    return 1;
+}
+
+// Sort the records of input into a temporary file, rewound for reading
+FILE* sortRecords(FILE* input) {
+    ExternalSort sort;
+    memset(&sort, 0, sizeof(sort));
+    sort.arena = malloc(SORT_CHUNK);
+    if (!sort.arena) {
+        perror("Failed to allocate the sort chunk");
+        return NULL;
+    }
+
+    MergeInput reader;
+    memset(&reader, 0, sizeof(reader));
+    reader.file = input;
+    int sorted = 1;
+    while (sorted && advanceMergeInput(&reader)) {
+        sorted = addSortRecord(&sort, reader.line, reader.key);
+    }
+    sorted = sorted && flushSortChunk(&sort);
+    free(reader.line);
+    free(sort.arena);
+    free(sort.records);
+
+    // What is left is at most one partial level each, merged for good
+    FILE* left[SORT_LEVELS * SORT_FAN_IN];
+    int leftCount = 0;
+    for (int level = 0; level < SORT_LEVELS; level++) {
+        for (int i = 0; i < sort.runCount[level]; i++) {
+            left[leftCount++] = sort.runs[level][i];
+        }
+    }
+    if (!sorted) {
+        for (int i = 0; i < leftCount; i++) {
+            fclose(left[i]);
+        }
+        return NULL;
+    }
+    FILE* result = leftCount == 1 ? left[0] : mergeRuns(left, leftCount);
+    if (result) {
+        rewind(result);
+    }
+    return result;
+}
+
+// Whether the records of a file come sorted by path, read from where it is
+int recordsSorted(FILE* file) {
+    MergeInput reader;
+    memset(&reader, 0, sizeof(reader));
+    reader.file = file;
+    char previous[PATH_MAX] = "";
+    int sorted = 1;
+    while (sorted && advanceMergeInput(&reader)) {
+        sorted = strcmp(previous, reader.key) <= 0;
+        memcpy(previous, reader.key, sizeof(previous));
+    }
+    free(reader.line);
+    return sorted;
+}
+
+// Open an output for the join. A sorted regular file is read as it is, anything
+// else goes through the external sort.
+FILE* openSortedRecords(const char* path) {
+    FILE* file = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    if (!file) {
+        perror(path);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fileno(file), &st) == 0 && S_ISREG(st.st_mode)) {
+        int sorted = recordsSorted(file);
+        rewind(file);
+        if (sorted) {
+            return file;
+        }
+    }
+    LOG(LOG_INFO, "Sorting %s\n", path);
+    FILE* sorted = sortRecords(file);
+    if (file != stdin) {
+        fclose(file);
+    }
+    return sorted;
+}
+
+// One line of the diff, with the old and new target when there are
+void printChange(const char* change, const char* lnkPath, const char* oldTarget, const char* newTarget) {
+    printf("{\"change\":\"%s\",\"lnk\":", change);
+    writeJsonString(stdout, lnkPath);
+    if (oldTarget) {
+        fputs(",\"old\":", stdout);
+        writeJsonString(stdout, oldTarget);
+    }
+    if (newTarget) {
+        fputs(",\"new\":", stdout);
+        writeJsonString(stdout, newTarget);
+    }
+    fputs("}\n", stdout);
+}
+
+// The target of a record, NULL when it has none
+const char* recordTarget(MergeInput* input, char* target, int size) {
+    return readJsonField(input->line, "target", target, size) >= 0 ? target : NULL;
+}
+
+// --diff OLD NEW: the shortcuts added, removed and retargeted between two
+// --resolve, --scan or --merge outputs, as a merge-join on the shortcut path
+int diffOutputs(const char* oldPath, const char* newPath) {
+    MergeInput inputs[2];
+    memset(inputs, 0, sizeof(inputs));
+    inputs[0].file = openSortedRecords(oldPath);
+    inputs[1].file = inputs[0].file ? openSortedRecords(newPath) : NULL;
+    if (!inputs[1].file) {
+        if (inputs[0].file && inputs[0].file != stdin) {
+            fclose(inputs[0].file);
+        }
+        return 1;
+    }
+
+    static char oldTarget[MAX_DATA_SIZE], newTarget[MAX_DATA_SIZE];
+    long counts[3] = {0};
+    int oldLive = advanceMergeInput(&inputs[0]);
+    int newLive = advanceMergeInput(&inputs[1]);
+    while (oldLive || newLive) {
+        int order = !oldLive ? 1 : !newLive ? -1 : strcmp(inputs[0].key, inputs[1].key);
+        if (order < 0) {
+            printChange("removed", inputs[0].key, recordTarget(&inputs[0], oldTarget, sizeof(oldTarget)), NULL);
+            counts[0]++;
+        } else if (order > 0) {
+            printChange("added", inputs[1].key, NULL, recordTarget(&inputs[1], newTarget, sizeof(newTarget)));
+            counts[1]++;
+        } else {
+            const char* from = recordTarget(&inputs[0], oldTarget, sizeof(oldTarget));
+            const char* to = recordTarget(&inputs[1], newTarget, sizeof(newTarget));
+            if (!from != !to || (from && strcmp(from, to) != 0)) {
+                printChange("retargeted", inputs[0].key, from, to);
+                counts[2]++;
+            }
+        }
+        if (order <= 0) {
+            oldLive = advanceMergeInput(&inputs[0]);
+        }
+        if (order >= 0) {
+            newLive = advanceMergeInput(&inputs[1]);
+        }
+    }
+    LOG(LOG_INFO, "%ld removed, %ld added, %ld retargeted\n", counts[0], counts[1], counts[2]);
+
+    for (int i = 0; i < 2; i++) {
+        if (inputs[i].file != stdin) {
+            fclose(inputs[i].file);
+        }
+        free(inputs[i].line);
+    }
+    return 0;
+}
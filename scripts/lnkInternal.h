@@ -0,0 +1,274 @@
+// What the files of open_lnk share with each other: the parser in lnkParse.c,
+// the resolver and its caches in lnkResolve.c, the modes in the other lnk*.c
+// files and main in lnkReader.c. lnkReader.h holds the public calls; the Python
+// module and the benchmarks build on this header instead.
+
+#ifndef LNK_INTERNAL_H
+#define LNK_INTERNAL_H
+
+// Embedders such as Python.h may have defined it already
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <regex.h>
+#include <sys/utsname.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <errno.h>
+#include <sys/syscall.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+#include "lnkReader.h"
+
+// USDT probes for bpftrace, perf and SystemTap, e.g.
+//   bpftrace -e 'usdt:./open_lnk:open_lnk:mount_probe { printf("%s\n", str(arg0)); }'
+// Without sys/sdt.h they compile to nothing. Enabled or not, an idle probe is one nop.
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define TRACE(...) STAP_PROBEV(open_lnk, __VA_ARGS__)
+#else
+#define TRACE(...) do { } while (0)
+#endif
+
+
+#define MAX_DATA_SIZE 4096
+#define MAX_PATH_LEN 1024
+#define MAX_PATH_DEPTH 128
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define SLOW_PROBE_US 50000
+
+// Offsets and flags of the MS-SHLLINK structures we read
+#define LNK_HEADER_SIZE 0x4C
+#define LNK_HAS_ID_LIST 0x1
+#define LNK_HAS_LINK_INFO 0x2
+#define LNK_HAS_NAME 0x4
+#define LNK_HAS_RELATIVE_PATH 0x8
+#define LNK_HAS_WORKING_DIR 0x10
+#define LNK_HAS_ARGUMENTS 0x20
+#define LNK_HAS_ICON_LOCATION 0x40
+#define LNK_IS_UNICODE 0x80
+#define LINK_INFO_VOLUME_ID 0x1
+#define LINK_INFO_NETWORK 0x2
+#define EXTRA_ENVIRONMENT_BLOCK 0xA0000001
+#define EXTRA_KNOWN_FOLDER_BLOCK 0xA000000B
+#define EXTRA_ICON_ENVIRONMENT_BLOCK 0xA0000007
+
+// Fields pulled out of the .lnk header, IDList, LinkInfo, StringData and ExtraData structures
+typedef struct {
+    int valid;                          // Header size and CLSID matched
+    unsigned int linkFlags;
+    unsigned int fileSize;              // Target size recorded when the link was made
+    unsigned long long writeTime;       // Target write time, as a Windows FILETIME
+    unsigned int driveType;             // VolumeID DriveType (2 removable, 3 fixed, 4 network...)
+    unsigned int driveSerial;           // VolumeID serial number, 0 when unknown
+    char volumeLabel[64];
+    char localBasePath[MAX_PATH_LEN];
+    char commonPathSuffix[MAX_PATH_LEN];
+    char netName[256];                  // UNC share of a network link ("\\server\share")
+    char deviceName[8];                 // Drive letter the share was mapped to ("G:")
+    char relativePath[MAX_PATH_LEN];    // StringData RELATIVE_PATH, relative to the .lnk itself
+    char environmentPath[MAX_PATH_LEN]; // EnvironmentVariableDataBlock target ("%USERPROFILE%\...")
+    char idListPath[MAX_PATH_LEN];      // Path rebuilt from the LinkTargetIDList items
+    unsigned char knownFolderId[16];    // KnownFolderDataBlock GUID, as stored on disk
+    int hasKnownFolder;
+    char knownFolderSubPath[MAX_PATH_LEN]; // IDList items below the known folder
+    long long lnkSize;                  // Size of the .lnk file itself, set by resolveLnkFile()
+    char iconLocation[MAX_PATH_LEN];    // StringData ICON_LOCATION, else IconEnvironmentDataBlock
+    int iconIndex;                      // Icon within iconLocation
+} LnkInfo;
+
+
+// lnkLog.c
+// Leveled diagnostics on stderr. A disabled level costs one compare and its
+// arguments are never evaluated; levels above LOG_MAX_LEVEL (-DLOG_MAX_LEVEL=...)
+// are not even compiled in.
+enum {
+    LOG_OFF,
+    LOG_ERROR,
+    LOG_WARN,
+    LOG_INFO,
+    LOG_DEBUG
+};
+
+#ifndef LOG_MAX_LEVEL
+#define LOG_MAX_LEVEL LOG_DEBUG
+#endif
+
+#define LOG(level, ...) do { if ((level) <= LOG_MAX_LEVEL && (level) <= logLevel) logWrite(__VA_ARGS__); } while (0)
+
+extern int logLevel;
+extern char notifyCmdFormat[256];
+
+__attribute__((format(printf, 1, 2)))
+void logWrite(const char* format, ...);
+void flushLog(void);
+void initLog(int defaultLevel);
+void showError(const char* message);
+
+
+// lnkMetrics.c
+// Log-linear buckets as in HDR histograms: every power of two is split into
+// 2^HISTOGRAM_SUB_BITS linear steps, so a bucket is at most 25% wide. Values
+// up to 2^HISTOGRAM_MAX_BITS are told apart, larger ones share the last bucket.
+#define HISTOGRAM_SUB_BITS 2
+#define HISTOGRAM_MAX_BITS 28
+#define HISTOGRAM_BUCKETS ((HISTOGRAM_MAX_BITS - 1) << HISTOGRAM_SUB_BITS)
+
+typedef struct {
+    const char* name;
+    const char* help;
+    atomic_long buckets[HISTOGRAM_BUCKETS];
+    atomic_long count;
+    atomic_long sum;
+} Histogram;
+
+enum {
+    CACHE_LEARNED,
+    CACHE_NEGATIVE,
+    CACHE_KINDS
+};
+
+extern int metricsEnabled;
+extern atomic_long requestsTotal[RESULT_UNREADABLE + 1];
+extern atomic_long parseErrorsTotal;
+extern atomic_long cacheHitsTotal[CACHE_KINDS];
+extern atomic_long cacheMissesTotal[CACHE_KINDS];
+extern atomic_long probesTotal;
+extern atomic_long launchFailuresTotal;
+extern Histogram requestLatency;
+extern Histogram probesPerRequest;
+extern char metricsFile[MAX_PATH_LEN];
+extern char metricsSocket[sizeof(((struct sockaddr_un*) 0)->sun_path)];
+
+long long monotonicMicros(void);
+void observe(Histogram* histogram, long long value);
+void countSlowProbe(const char* mountpoint);
+int startMetrics(void);
+
+
+// lnkParse.c
+char* binaryToASCII(const unsigned char* data, int length);
+char* findLongestValidPath(const char* str);
+unsigned int readU16(const unsigned char* p);
+unsigned int readU32(const unsigned char* p);
+void copyAnsiString(char* dest, int destSize, const unsigned char* data, unsigned int start, unsigned int length);
+void copyUtf16String(char* dest, int destSize, const unsigned char* data, unsigned int count);
+void appendPathComponent(char* path, int size, const char* component);
+int parseLnk(const unsigned char* data, int length, LnkInfo* info);
+char* buildLinkInfoPath(const LnkInfo* info);
+long long filetimeToUnix(unsigned long long filetime);
+char* recordedTarget(const LnkInfo* info);
+
+
+// lnkResolve.c
+// Where the resolver reads its mount table from and how it looks paths up below
+// a mount. The default goes to /proc/mounts and the real filesystem; benchmarks
+// swap in a fake one through setResolverFs().
+typedef struct {
+    const char* mountsPath;
+    int watchMounts;
+    int (*openDir)(int dirFd, const char* path, int confine);
+    int (*probe)(int dirFd, const char* relPath, struct stat* st, int confine);
+    void (*closeDir)(int fd);
+} ResolverFs;
+
+extern const ResolverFs realResolverFs;
+extern const char* resultNames[];
+
+void loadDriveMap(void);
+unsigned long long hashBytes(unsigned long long hash, const char* data, size_t length);
+void setResolverFs(const ResolverFs* fs);
+int driveCacheFile(char* path, int size, int createDir);
+char* findMountedPath(const char* foundPath, const LnkInfo* info, atomic_int* cancel);
+int resolveLnkData(const char* lnkPath, const unsigned char* data, int length, char** targetPath, LnkInfo* info, long long start);
+int resolveLnkFile(const char* lnkPath, char** targetPath, LnkInfo* info);
+
+
+// lnkAlloc.c, built with -DLNK_ALLOC_STATS
+#ifdef LNK_ALLOC_STATS
+// Counters at the start of one shortcut, and run wide peaks
+typedef struct {
+    long count;
+    long bytes;
+} AllocMark;
+
+extern atomic_int allocSteady;
+extern int allocWarmupFiles;
+
+void beginAllocFile(AllocMark* mark);
+void endAllocFile(const AllocMark* mark, FILE* out);
+void printAllocSummary(void);
+#endif
+
+
+// lnkScan.c
+// One input of --merge: its current line and the path that line is about
+typedef struct {
+    FILE* file;
+    char* line;
+    size_t capacity;
+    char key[PATH_MAX];
+} MergeInput;
+
+extern int shardIndex;
+extern int shardCount;
+extern int shardDepth;
+extern char checkpointFile[MAX_PATH_LEN];
+extern int resumeScan;
+
+void writeJsonString(FILE* out, const char* str);
+int inShard(const char* path);
+void writeResolvedRecord(const char* lnkPath, int result, const char* targetPath);
+int resolveBulk(int count, char* paths[]);
+int hasLnkExtension(const char* name);
+int scanStats(int count, char* roots[]);
+int scanResolve(int count, char* roots[]);
+int readJsonField(const char* line, const char* field, char* out, int size);
+int advanceMergeInput(MergeInput* input);
+int mergeInputs(MergeInput* inputs, int count, FILE* out);
+int mergeOutputs(int count, char* paths[]);
+
+
+// lnkDiff.c
+int diffOutputs(const char* oldPath, const char* newPath);
+
+
+// lnkCarve.c
+void writeRecordedTarget(FILE* out, const LnkInfo* info, const char* target);
+int mapFile(const char* path, const unsigned char** data, size_t* size);
+int carveFile(const char* path);
+
+
+// lnkJumpList.c
+int readJumpLists(int count, char* paths[]);
+
+
+// lnkArchive.c
+int resolveArchive(const char* path);
+
+
+// lnkServe.c
+#define COPROC_WORKERS 8
+#define COPROC_MAX_WORKERS 64
+
+int resolveStdinStream(void);
+int runCoproc(int workerCount);
+
+#endif
@@ -0,0 +1,315 @@
+// --jumplist: the shortcuts inside Windows jump lists
+
+#include "lnkInternal.h"
+
+
+/*
+ _ _  _ _  _ ___     _    _ ____ ___ ____ 
+ | |  | |\/| |__]    |    | [__   |  [__  
+_| |__| |  | |       |___ | ___]  |  ___] 
+
+*/
+
+// A jump list (*.automaticDestinations-ms) is an OLE compound file: a FAT of
+// sector chains, a MiniFAT of 64-byte sectors for small streams, and one
+// stream per shortcut named by its DestList entry number in hex. The file is
+// mapped and only the sector numbers of the FAT and MiniFAT are collected;
+// a stream whose sectors follow each other is parsed where it lies.
+#define CFB_END_OF_CHAIN 0xFFFFFFFE
+#define CFB_DIFAT_IN_HEADER 109
+#define CFB_ENTRY_SIZE 128
+
+typedef struct {
+    const unsigned char* data;
+    size_t size;
+    unsigned int sectorShift;
+    unsigned int miniSectorShift;
+    unsigned int miniCutoff;        // Streams smaller than this live in the mini stream
+    int wideSizes;                  // Version 4: stream sizes are 64-bit
+    unsigned int* fatSectors;       // Sectors holding the FAT, in order
+    unsigned int fatCount;
+    unsigned int* miniFatSectors;   // Sectors holding the MiniFAT, in order
+    unsigned int miniFatCount;
+    const unsigned char* directory;
+    size_t directorySize;
+    const unsigned char* miniStream;
+    size_t miniStreamSize;
+    unsigned char* ownedDirectory;  // Copies of chains that were not contiguous
+    unsigned char* ownedMiniStream;
+} CfbFile;
+
+// Start of a regular sector, or NULL when it lies past the end of the file
+const unsigned char* cfbSector(const CfbFile* cfb, unsigned int sector) {
+    size_t offset = ((size_t) sector + 1) << cfb->sectorShift;
+    return sector < CFB_END_OF_CHAIN && offset + ((size_t) 1 << cfb->sectorShift) <= cfb->size ? cfb->data + offset : NULL;
+}
+
+// The sector after this one in its chain, from the FAT or the MiniFAT
+unsigned int cfbNextSector(const CfbFile* cfb, unsigned int sector, int mini) {
+    unsigned int perSector = (1u << cfb->sectorShift) / 4;
+    unsigned int index = sector / perSector;
+    if (index >= (mini ? cfb->miniFatCount : cfb->fatCount)) {
+        return CFB_END_OF_CHAIN;
+    }
+    const unsigned char* table = cfbSector(cfb, mini ? cfb->miniFatSectors[index] : cfb->fatSectors[index]);
+    return table ? readU32(table + (sector % perSector) * 4) : CFB_END_OF_CHAIN;
+}
+
+// The sector numbers of a chain, at most max of them. Returns how many there were.
+unsigned int cfbChain(const CfbFile* cfb, unsigned int start, unsigned int* sectors, unsigned int max) {
+    unsigned int count = 0;
+    for (unsigned int sector = start; sector < CFB_END_OF_CHAIN && count < max; sector = cfbNextSector(cfb, sector, 0)) {
+        sectors[count++] = sector;
+    }
+    return count;
+}
+
+// A stream of size bytes from its first sector. Points into the file, or into
+// the mini stream, when the chain is contiguous; otherwise it is gathered into
+// *owned, which the caller frees. NULL when the chain is broken.
+const unsigned char* cfbStream(const CfbFile* cfb, unsigned int start, size_t size, int mini, unsigned char** owned) {
+    *owned = NULL;
+    unsigned int shift = mini ? cfb->miniSectorShift : cfb->sectorShift;
+    const unsigned char* base = mini ? cfb->miniStream : cfb->data;
+    size_t baseSize = mini ? cfb->miniStreamSize : cfb->size;
+    size_t sectorSize = (size_t) 1 << shift;
+    // Regular sector n starts one sector in, after the header
+    size_t skip = mini ? 0 : 1;
+    if (!size || !base) {
+        return NULL;
+    }
+
+    // The chain can not be longer than the file, which also ends loops
+    size_t sectorCount = (size + sectorSize - 1) / sectorSize;
+    if (sectorCount > baseSize / sectorSize) {
+        return NULL;
+    }
+    const unsigned char* first = NULL;
+    unsigned int sector = start;
+    for (size_t i = 0; i < sectorCount; i++, sector = cfbNextSector(cfb, sector, mini)) {
+        size_t offset = (sector + skip) << shift;
+        if (sector >= CFB_END_OF_CHAIN || offset + sectorSize > baseSize) {
+            free(*owned);
+            *owned = NULL;
+            return NULL;
+        }
+        if (i == 0) {
+            first = base + offset;
+        }
+        // Gather from the first gap on
+        if (!*owned && base + offset != first + i * sectorSize) {
+            *owned = malloc(sectorCount * sectorSize);
+            if (!*owned) {
+                perror("Failed to allocate a stream");
+                return NULL;
+            }
+            memcpy(*owned, first, i * sectorSize);
+        }
+        if (*owned) {
+            memcpy(*owned + i * sectorSize, base + offset, sectorSize);
+        }
+    }
+    return *owned ? *owned : first;
+}
+
+void closeCfb(CfbFile* cfb) {
+    free(cfb->fatSectors);
+    free(cfb->miniFatSectors);
+    free(cfb->ownedDirectory);
+    free(cfb->ownedMiniStream);
+}
+
+// Read the header, the FAT and MiniFAT sector lists, the directory and the
+// mini stream of a compound file. Returns 0 when it is not one.
+int openCfb(CfbFile* cfb, const unsigned char* data, size_t size) {
+    static const unsigned char signature[8] = {0xD0, 0xCF, 0x11, 0xE0, 0xA1, 0xB1, 0x1A, 0xE1};
+    memset(cfb, 0, sizeof(*cfb));
+    if (size < 512 || memcmp(data, signature, sizeof(signature)) != 0) {
+        return 0;
+    }
+    cfb->data = data;
+    cfb->size = size;
+    cfb->sectorShift = readU16(data + 0x1E);
+    cfb->miniSectorShift = readU16(data + 0x20);
+    cfb->miniCutoff = readU32(data + 0x38);
+    cfb->wideSizes = readU16(data + 0x1A) >= 4;
+    if ((cfb->sectorShift != 9 && cfb->sectorShift != 12) || cfb->miniSectorShift != 6) {
+        return 0;
+    }
+    unsigned int sectorSize = 1u << cfb->sectorShift;
+    unsigned int maxSectors = size >> cfb->sectorShift;
+
+    // FAT sectors: 109 listed in the header, the rest in a chain of DIFAT sectors
+    // that each end with the number of the next one
+    unsigned int fatCount = readU32(data + 0x2C);
+    if (fatCount > maxSectors || !(cfb->fatSectors = malloc((fatCount + 1) * sizeof(unsigned int)))) {
+        return 0;
+    }
+    unsigned int difat = readU32(data + 0x44);
+    for (unsigned int i = 0; i < fatCount; i++) {
+        if (i < CFB_DIFAT_IN_HEADER) {
+            cfb->fatSectors[i] = readU32(data + 0x4C + i * 4);
+            continue;
+        }
+        unsigned int perDifat = sectorSize / 4 - 1;
+        unsigned int at = (i - CFB_DIFAT_IN_HEADER) % perDifat;
+        if (at == 0 && i > CFB_DIFAT_IN_HEADER) {
+            const unsigned char* previous = cfbSector(cfb, difat);
+            difat = previous ? readU32(previous + perDifat * 4) : CFB_END_OF_CHAIN;
+        }
+        const unsigned char* sector = cfbSector(cfb, difat);
+        if (!sector) {
+            fatCount = i;
+            break;
+        }
+        cfb->fatSectors[i] = readU32(sector + at * 4);
+    }
+    cfb->fatCount = fatCount;
+
+    // MiniFAT sectors are a chain of the FAT like any stream
+    unsigned int miniFatCount = readU32(data + 0x40);
+    if (miniFatCount > maxSectors || !(cfb->miniFatSectors = malloc((miniFatCount + 1) * sizeof(unsigned int)))) {
+        closeCfb(cfb);
+        return 0;
+    }
+    cfb->miniFatCount = cfbChain(cfb, readU32(data + 0x3C), cfb->miniFatSectors, miniFatCount);
+
+    // The directory has no size of its own, its chain says how long it is
+    unsigned int directoryStart = readU32(data + 0x30);
+    unsigned int directorySectors = 0;
+    for (unsigned int sector = directoryStart; sector < CFB_END_OF_CHAIN && directorySectors < maxSectors; sector = cfbNextSector(cfb, sector, 0)) {
+        directorySectors++;
+    }
+    cfb->directorySize = (size_t) directorySectors << cfb->sectorShift;
+    cfb->directory = cfbStream(cfb, directoryStart, cfb->directorySize, 0, &cfb->ownedDirectory);
+    if (!cfb->directory || cfb->directorySize < CFB_ENTRY_SIZE) {
+        closeCfb(cfb);
+        return 0;
+    }
+
+    // The root entry holds the mini stream
+    const unsigned char* root = cfb->directory;
+    size_t miniStreamSize = cfb->wideSizes ? readU32(root + 0x78) | ((size_t) readU32(root + 0x7C) << 32) : readU32(root + 0x78);
+    if (miniStreamSize) {
+        size_t rounded = (miniStreamSize + sectorSize - 1) & ~(size_t) (sectorSize - 1);
+        cfb->miniStream = cfbStream(cfb, readU32(root + 0x74), rounded, 0, &cfb->ownedMiniStream);
+        cfb->miniStreamSize = cfb->miniStream ? miniStreamSize : 0;
+    }
+    return 1;
+}
+
+// Find a stream by name in the directory. Returns its data as cfbStream() does.
+const unsigned char* cfbFindStream(const CfbFile* cfb, const char* name, size_t* size, unsigned char** owned) {
+    *owned = NULL;
+    for (size_t offset = 0; offset + CFB_ENTRY_SIZE <= cfb->directorySize; offset += CFB_ENTRY_SIZE) {
+        const unsigned char* entry = cfb->directory + offset;
+        unsigned int nameBytes = readU16(entry + 0x40);
+        if (entry[0x42] != 2 || nameBytes < 2 || nameBytes > 64) {
+            continue;   // Not a stream
+        }
+        char entryName[32];
+        copyUtf16String(entryName, sizeof(entryName), entry, nameBytes / 2);
+        if (strcasecmp(entryName, name) != 0) {
+            continue;
+        }
+
+        *size = cfb->wideSizes ? readU32(entry + 0x78) | ((size_t) readU32(entry + 0x7C) << 32) : readU32(entry + 0x78);
+        return cfbStream(cfb, readU32(entry + 0x74), *size, *size < cfb->miniCutoff, owned);
+    }
+    return NULL;
+}
+
+// DestList entries: 130 bytes before the path from version 3 on (Windows 10),
+// 114 before. The fields used are at the same offsets in both.
+#define DESTLIST_HEADER_SIZE 32
+#define DESTLIST_ENTRY_SIZE_V1 114
+#define DESTLIST_ENTRY_SIZE_V3 130
+
+// One record per DestList entry, most recent first, with the shortcut stream
+// of the entry parsed
+int readJumpList(const char* path) {
+    const unsigned char* data;
+    size_t size;
+    if (!mapFile(path, &data, &size)) {
+        return 0;
+    }
+    CfbFile cfb;
+    if (!data || !openCfb(&cfb, data, size)) {
+        LOG(LOG_WARN, "%s is not a compound file\n", path);
+        if (data) {
+            munmap((void*) data, size);
+        }
+        return 0;
+    }
+
+    size_t destListSize = 0;
+    unsigned char* ownedDestList;
+    const unsigned char* destList = cfbFindStream(&cfb, "DestList", &destListSize, &ownedDestList);
+    if (!destList || destListSize < DESTLIST_HEADER_SIZE) {
+        LOG(LOG_WARN, "%s has no DestList\n", path);
+        free(ownedDestList);
+        closeCfb(&cfb);
+        munmap((void*) data, size);
+        return 0;
+    }
+    unsigned int version = readU32(destList);
+    unsigned int entrySize = version >= 3 ? DESTLIST_ENTRY_SIZE_V3 : DESTLIST_ENTRY_SIZE_V1;
+
+    size_t offset = DESTLIST_HEADER_SIZE;
+    static char entryPath[MAX_PATH_LEN];
+    while (offset + entrySize <= destListSize) {
+        const unsigned char* entry = destList + offset;
+        unsigned int pathChars = readU16(entry + entrySize - 2);
+        if (pathChars * 2 > destListSize - offset - entrySize) {
+            break;
+        }
+        copyUtf16String(entryPath, sizeof(entryPath), entry + entrySize, pathChars);
+        offset += entrySize + pathChars * 2 + (version >= 3 ? 4 : 0);
+
+        unsigned int number = readU32(entry + 0x58);
+        char host[17];
+        copyAnsiString(host, sizeof(host), entry, 0x48, 0x58);
+
+        fputs("{\"jumplist\":", stdout);
+        writeJsonString(stdout, path);
+        printf(",\"entry\":%u,\"host\":", number);
+        writeJsonString(stdout, host);
+        printf(",\"accessed\":%lld,\"pinned\":%s,\"path\":", filetimeToUnix(readU32(entry + 0x64) | ((unsigned long long) readU32(entry + 0x68) << 32)),
+            (int) readU32(entry + 0x6C) == -1 ? "false" : "true");
+        writeJsonString(stdout, entryPath);
+
+        // Its shortcut, parsed straight from the sectors
+        char streamName[16];
+        snprintf(streamName, sizeof(streamName), "%x", number);
+        size_t lnkSize = 0;
+        unsigned char* ownedLnk;
+        const unsigned char* lnk = cfbFindStream(&cfb, streamName, &lnkSize, &ownedLnk);
+        LnkInfo info;
+        char* target = NULL;
+        if (lnk && lnkSize <= INT_MAX && parseLnk(lnk, (int) lnkSize, &info)) {
+            target = recordedTarget(&info);
+        }
+        if (target) {
+            writeRecordedTarget(stdout, &info, target);
+        }
+        fputs("}\n", stdout);
+        free(target);
+        free(ownedLnk);
+    }
+
+    free(ownedDestList);
+    closeCfb(&cfb);
+    munmap((void*) data, size);
+    return 1;
+}
+
+// --jumplist FILE...: the entries of *.automaticDestinations-ms jump lists
+int readJumpLists(int count, char* paths[]) {
+    int status = 0;
+    for (int i = 0; i < count; i++) {
+        if (!readJumpList(paths[i])) {
+            status = 1;
+        }
+    }
+    return status;
+}
@@ -0,0 +1,103 @@
+// Leveled logging on stderr, and error notifications on the desktop
+
+#include "lnkInternal.h"
+
+
+/*
+_    ____ ____ 
+|    |  | | __ 
+|___ |__| |__] 
+
+*/
+
+// Global variable to hold the notification command
+char notifyCmdFormat[256] = {0};
+
+// Enabled lines collect in a large buffer that is written out when full and at
+// exit, not one write() per line
+#define LOG_BUFFER_SIZE 65536
+
+int logLevel = LOG_INFO;
+char logBuffer[LOG_BUFFER_SIZE];
+int logLength = 0;
+pthread_mutex_t logLock = PTHREAD_MUTEX_INITIALIZER;
+
+// Write out the buffer. Only called with logLock held, or at exit.
+void flushLogLocked(void) {
+    int written = 0;
+    while (written < logLength) {
+        ssize_t n = write(STDERR_FILENO, logBuffer + written, logLength - written);
+        if (n <= 0 && errno != EINTR) {
+            break;
+        }
+        written += n > 0 ? (int) n : 0;
+    }
+    logLength = 0;
+}
+
+void flushLog(void) {
+    pthread_mutex_lock(&logLock);
+    flushLogLocked();
+    pthread_mutex_unlock(&logLock);
+}
+
+__attribute__((format(printf, 1, 2)))
+void logWrite(const char* format, ...) {
+    va_list args;
+    pthread_mutex_lock(&logLock);
+
+    // Format in place, flushing first when the line does not fit. A line
+    // longer than the whole buffer is cut.
+    for (int attempt = 0; attempt < 2; attempt++) {
+        va_start(args, format);
+        int length = vsnprintf(logBuffer + logLength, LOG_BUFFER_SIZE - logLength, format, args);
+        va_end(args);
+
+        if (length < 0) {
+            break;
+        }
+        if (logLength + length < LOG_BUFFER_SIZE) {
+            logLength += length;
+            break;
+        }
+        if (attempt || logLength == 0) {
+            logLength = LOG_BUFFER_SIZE - 1;
+            break;
+        }
+        flushLogLocked();
+    }
+    pthread_mutex_unlock(&logLock);
+}
+
+// Pick the level from OPEN_LNK_LOG (off, error, warn, info, debug), defaulting
+// to the one given, and make sure the buffer is written at exit
+void initLog(int defaultLevel) {
+    static const char* names[] = {"off", "error", "warn", "info", "debug"};
+    const char* wanted = getenv("OPEN_LNK_LOG");
+
+    logLevel = defaultLevel;
+    for (int i = 0; wanted && i <= LOG_DEBUG; i++) {
+        if (strcasecmp(wanted, names[i]) == 0) {
+            logLevel = i;
+        }
+    }
+
+    // lnkInit() sets up the logger before main picks the level, flush only once
+    static int flushRegistered = 0;
+    if (!flushRegistered) {
+        atexit(flushLog);
+        flushRegistered = 1;
+    }
+}
+
+// Display an error message using the appropriate method for the current OS
+void showError(const char* message) {
+    if (!notifyCmdFormat[0]) {
+        LOG(LOG_ERROR, "Unknown OS. Cannot display notification.\n");
+        return;
+    }
+
+    char cmd[1024];
+    sprintf(cmd, notifyCmdFormat, message);
+    system(cmd);
+}
@@ -0,0 +1,265 @@
+// Counters and histograms of open_lnk, and their Prometheus exporters
+
+#include "lnkInternal.h"
+
+
+/*
+_  _ ____ ___ ____ _ ____ ____ 
+|\/| |___  |  |__/ | |    [__  
+|  | |___  |  |  \ | |___ ___] 
+
+*/
+
+// Counters and latency histograms, exported in Prometheus text format to a file
+// rewritten every METRICS_INTERVAL seconds (--metrics-file) or to whoever
+// connects to a Unix socket (--metrics-socket)
+
+#define MAX_SLOW_MOUNTS 64
+#define METRICS_INTERVAL 10
+
+// Probes slower than SLOW_PROBE_US, by mountpoint
+typedef struct {
+    char mountpoint[MAX_PATH_LEN];
+    atomic_long count;
+} SlowMount;
+
+const char* cacheNames[] = {"learned", "negative"};
+
+int metricsEnabled = 0;
+atomic_long requestsTotal[RESULT_UNREADABLE + 1];
+atomic_long parseErrorsTotal = 0;
+atomic_long cacheHitsTotal[CACHE_KINDS];
+atomic_long cacheMissesTotal[CACHE_KINDS];
+atomic_long probesTotal = 0;
+atomic_long launchFailuresTotal = 0;
+Histogram requestLatency = {"open_lnk_request_duration_microseconds", "Time to resolve one shortcut", {0}, 0, 0};
+Histogram probesPerRequest = {"open_lnk_probes_per_request", "Mounts probed by one mount sweep", {0}, 0, 0};
+SlowMount slowMounts[MAX_SLOW_MOUNTS];
+int slowMountCount = 0;
+pthread_mutex_t slowMountLock = PTHREAD_MUTEX_INITIALIZER;
+char metricsFile[MAX_PATH_LEN] = "";
+char metricsSocket[sizeof(((struct sockaddr_un*) 0)->sun_path)] = "";
+
+long long monotonicMicros(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000LL + now.tv_nsec / 1000;
+}
+
+int histogramBucket(unsigned long long value) {
+    if (value < (1 << HISTOGRAM_SUB_BITS)) {
+        return (int) value;
+    }
+    int shift = 63 - __builtin_clzll(value) - HISTOGRAM_SUB_BITS;
+    int bucket = ((shift + 1) << HISTOGRAM_SUB_BITS) + (int) ((value >> shift) & ((1 << HISTOGRAM_SUB_BITS) - 1));
+    return bucket < HISTOGRAM_BUCKETS ? bucket : HISTOGRAM_BUCKETS - 1;
+}
+
+// Largest value that falls in a bucket, its "le" label
+unsigned long long histogramBucketTop(int bucket) {
+    if (bucket < (1 << HISTOGRAM_SUB_BITS)) {
+        return bucket;
+    }
+    int shift = (bucket >> HISTOGRAM_SUB_BITS) - 1;
+    unsigned long long step = (1 << HISTOGRAM_SUB_BITS) + (bucket & ((1 << HISTOGRAM_SUB_BITS) - 1));
+    return (step << shift) + (1ULL << shift) - 1;
+}
+
+void observe(Histogram* histogram, long long value) {
+    if (value < 0) {
+        value = 0;
+    }
+    atomic_fetch_add(&histogram->buckets[histogramBucket(value)], 1);
+    atomic_fetch_add(&histogram->count, 1);
+    atomic_fetch_add(&histogram->sum, value);
+}
+
+void countSlowProbe(const char* mountpoint) {
+    pthread_mutex_lock(&slowMountLock);
+    int i = 0;
+    while (i < slowMountCount && strcmp(slowMounts[i].mountpoint, mountpoint) != 0) {
+        i++;
+    }
+    if (i == slowMountCount && slowMountCount < MAX_SLOW_MOUNTS) {
+        snprintf(slowMounts[i].mountpoint, MAX_PATH_LEN, "%s", mountpoint);
+        slowMountCount++;
+    }
+    if (i < slowMountCount) {
+        atomic_fetch_add(&slowMounts[i].count, 1);
+    }
+    pthread_mutex_unlock(&slowMountLock);
+}
+
+// Label values escape backslashes, quotes and newlines
+void writeLabelValue(FILE* out, const char* value) {
+    for (const char* p = value; *p; p++) {
+        if (*p == '\\' || *p == '"') {
+            fputc('\\', out);
+            fputc(*p, out);
+        } else if (*p == '\n') {
+            fputs("\\n", out);
+        } else {
+            fputc(*p, out);
+        }
+    }
+}
+
+void writeHistogram(FILE* out, Histogram* histogram) {
+    fprintf(out, "# HELP %s %s\n# TYPE %s histogram\n", histogram->name, histogram->help, histogram->name);
+
+    // Buckets past the last used one add nothing, they are left out
+    int last = -1;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        if (atomic_load(&histogram->buckets[i])) {
+            last = i;
+        }
+    }
+    long cumulative = 0;
+    for (int i = 0; i <= last; i++) {
+        cumulative += atomic_load(&histogram->buckets[i]);
+        fprintf(out, "%s_bucket{le=\"%llu\"} %ld\n", histogram->name, histogramBucketTop(i), cumulative);
+    }
+    fprintf(out, "%s_bucket{le=\"+Inf\"} %ld\n", histogram->name, atomic_load(&histogram->count));
+    fprintf(out, "%s_sum %ld\n%s_count %ld\n", histogram->name, atomic_load(&histogram->sum), histogram->name, atomic_load(&histogram->count));
+}
+
+void writeMetrics(FILE* out) {
+    fputs("# HELP open_lnk_requests_total Shortcuts resolved, by outcome\n# TYPE open_lnk_requests_total counter\n", out);
+    for (int i = 0; i <= RESULT_UNREADABLE; i++) {
+        fprintf(out, "open_lnk_requests_total{status=\"%s\"} %ld\n", resultNames[i], atomic_load(&requestsTotal[i]));
+    }
+    fprintf(out, "# HELP open_lnk_parse_errors_total Shortcuts whose header could not be parsed\n# TYPE open_lnk_parse_errors_total counter\n"
+            "open_lnk_parse_errors_total %ld\n", atomic_load(&parseErrorsTotal));
+
+    fputs("# HELP open_lnk_cache_hits_total Lookups answered by a cache\n# TYPE open_lnk_cache_hits_total counter\n", out);
+    for (int i = 0; i < CACHE_KINDS; i++) {
+        fprintf(out, "open_lnk_cache_hits_total{cache=\"%s\"} %ld\n", cacheNames[i], atomic_load(&cacheHitsTotal[i]));
+    }
+    fputs("# HELP open_lnk_cache_misses_total Lookups a cache could not answer\n# TYPE open_lnk_cache_misses_total counter\n", out);
+    for (int i = 0; i < CACHE_KINDS; i++) {
+        fprintf(out, "open_lnk_cache_misses_total{cache=\"%s\"} %ld\n", cacheNames[i], atomic_load(&cacheMissesTotal[i]));
+    }
+
+    fprintf(out, "# HELP open_lnk_probes_total Mount candidates probed\n# TYPE open_lnk_probes_total counter\n"
+            "open_lnk_probes_total %ld\n", atomic_load(&probesTotal));
+    fprintf(out, "# HELP open_lnk_probe_timeouts_total Probes slower than %d us, by mount\n# TYPE open_lnk_probe_timeouts_total counter\n", SLOW_PROBE_US);
+    pthread_mutex_lock(&slowMountLock);
+    for (int i = 0; i < slowMountCount; i++) {
+        fputs("open_lnk_probe_timeouts_total{mount=\"", out);
+        writeLabelValue(out, slowMounts[i].mountpoint);
+        fprintf(out, "\"} %ld\n", atomic_load(&slowMounts[i].count));
+    }
+    pthread_mutex_unlock(&slowMountLock);
+    fprintf(out, "# HELP open_lnk_launch_failures_total Targets the default program failed to open\n# TYPE open_lnk_launch_failures_total counter\n"
+            "open_lnk_launch_failures_total %ld\n", atomic_load(&launchFailuresTotal));
+
+    writeHistogram(out, &requestLatency);
+    writeHistogram(out, &probesPerRequest);
+}
+
+// Replace the metrics file in one rename, a scraper never reads half of it
+void writeMetricsFile(void) {
+    char tmpPath[MAX_PATH_LEN + 8];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", metricsFile);
+    FILE* out = fopen(tmpPath, "w");
+    if (!out) {
+        return;
+    }
+    writeMetrics(out);
+    if (fclose(out) == 0) {
+        rename(tmpPath, metricsFile);
+    } else {
+        unlink(tmpPath);
+    }
+}
+
+void* metricsFileThread(void* arg) {
+    (void) arg;
+    for (;;) {
+        sleep(METRICS_INTERVAL);
+        writeMetricsFile();
+    }
+    return NULL;
+}
+
+// Every connection gets the current metrics, then is closed
+void* metricsSocketThread(void* arg) {
+    int listener = (int) (long) arg;
+    for (;;) {
+        int client = accept(listener, NULL, NULL);
+        if (client < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            return NULL;
+        }
+        // Formatted in memory and sent with MSG_NOSIGNAL: a scraper hanging up
+        // early must not kill the process with SIGPIPE
+        char* text = NULL;
+        size_t length = 0;
+        FILE* out = open_memstream(&text, &length);
+        if (out) {
+            writeMetrics(out);
+            fclose(out);
+            for (size_t sent = 0; sent < length;) {
+                ssize_t written = send(client, text + sent, length - sent, MSG_NOSIGNAL);
+                if (written < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (written <= 0) {
+                    break;
+                }
+                sent += written;
+            }
+            free(text);
+        }
+        close(client);
+    }
+    return NULL;
+}
+
+void stopMetrics(void) {
+    if (metricsFile[0]) {
+        writeMetricsFile();
+    }
+    if (metricsSocket[0]) {
+        unlink(metricsSocket);
+    }
+}
+
+// Start the exporters asked for on the command line
+int startMetrics(void) {
+    pthread_t thread;
+    metricsEnabled = metricsFile[0] || metricsSocket[0];
+    if (!metricsEnabled) {
+        return 1;
+    }
+
+    if (metricsFile[0] && pthread_create(&thread, NULL, metricsFileThread, NULL) == 0) {
+        pthread_detach(thread);
+    }
+
+    if (metricsSocket[0]) {
+        struct sockaddr_un address;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        snprintf(address.sun_path, sizeof(address.sun_path), "%s", metricsSocket);
+
+        int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        unlink(metricsSocket);
+        if (listener < 0 || bind(listener, (struct sockaddr*) &address, sizeof(address)) != 0 || listen(listener, 8) != 0) {
+            perror("Failed to open the metrics socket");
+            if (listener >= 0) {
+                close(listener);
+            }
+            metricsSocket[0] = '\0';
+            return 0;
+        }
+        if (pthread_create(&thread, NULL, metricsSocketThread, (void*) (long) listener) == 0) {
+            pthread_detach(thread);
+        }
+    }
+
+    atexit(stopMetrics);
+    return 1;
+}
@@ -0,0 +1,411 @@
+// The .lnk parser: MS-SHLLINK structures into LnkInfo, and the regex fallback
+// for anything else
+
+#include "lnkInternal.h"
+
+
+/*
+___  ____ ____ ____ ____ 
+|__] |__| |__/ [__  |___ 
+|    |  | |  \ ___] |___ 
+
+*/
+
+// Convert binary data to ASCII representation
+char* binaryToASCII(const unsigned char* data, int length) {
+    char* asciiStr = (char*) malloc(length + 1);
+    if (!asciiStr) {
+        perror("Failed to allocate memory for asciiStr");
+        exit(1);
+    }
+
+    for (int i = 0; i < length; i++) {
+        asciiStr[i] = (data[i] >= 32 && data[i] <= 126) || data[i] == '\n' || data[i] == '\t' ? data[i] : ' ';
+    }
+    asciiStr[length] = '\0';
+    return asciiStr;
+}
+
+char* findLongestValidPath(const char* str) {
+    regex_t regex;
+    regmatch_t matches[2];
+    // Regular expression pattern to match file paths
+    char pattern[] = "([A-Za-z]:[\\\\/][^ ]+( [^ ]+)*[^ ]*)";
+    char* longestPath = NULL;
+    int longestPathLen = 0;
+
+    // Compile the regular expression
+    if (regcomp(&regex, pattern, REG_EXTENDED)) {
+        showError("Failed to compile regex.");
+        return NULL;
+    }
+
+    const char* currentSearch = str;
+    // Search for matches repeatedly, aiming to find the longest match
+    while (!regexec(&regex, currentSearch, 2, matches, 0)) {
+        int start = matches[1].rm_so;
+        int end = matches[1].rm_eo;
+        int currentMatchLen = end - start;
+
+        // Check if the current match is longer than the previously found path
+        if (currentMatchLen > longestPathLen) {
+            free(longestPath);
+            longestPath = malloc(currentMatchLen + 1);
+            strncpy(longestPath, currentSearch + start, currentMatchLen);
+            longestPath[currentMatchLen] = '\0';
+            longestPathLen = currentMatchLen;
+        }
+        // Move the search starting point after the current match
+        currentSearch += end;
+    }
+
+    // Free up the memory used by the regex
+    regfree(&regex);
+    return longestPath;
+}
+
+// Read little-endian integers out of the raw .lnk bytes
+unsigned int readU16(const unsigned char* p) {
+    return p[0] | (p[1] << 8);
+}
+
+unsigned int readU32(const unsigned char* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int) p[3] << 24);
+}
+
+// Copy a NUL-terminated ANSI string out of a structure without running past its end
+void copyAnsiString(char* dest, int destSize, const unsigned char* data, unsigned int start, unsigned int length) {
+    int i = 0;
+    while (start < length && data[start] && i < destSize - 1) {
+        dest[i++] = data[start++];
+    }
+    dest[i] = '\0';
+}
+
+// Convert a counted UTF-16LE string to UTF-8, truncating at destSize
+void copyUtf16String(char* dest, int destSize, const unsigned char* data, unsigned int count) {
+    int out = 0;
+    for (unsigned int i = 0; i < count; i++) {
+        unsigned int c = readU16(data + i * 2);
+        if (c == 0) {
+            break;
+        }
+
+        // Join surrogate pairs into one code point
+        if (c >= 0xD800 && c <= 0xDBFF && i + 1 < count) {
+            unsigned int low = readU16(data + (i + 1) * 2);
+            if (low >= 0xDC00 && low <= 0xDFFF) {
+                c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+                i++;
+            }
+        }
+
+        char encoded[4];
+        int n;
+        if (c < 0x80) {
+            encoded[0] = (char) c;
+            n = 1;
+        } else if (c < 0x800) {
+            encoded[0] = (char) (0xC0 | (c >> 6));
+            encoded[1] = (char) (0x80 | (c & 0x3F));
+            n = 2;
+        } else if (c < 0x10000) {
+            encoded[0] = (char) (0xE0 | (c >> 12));
+            encoded[1] = (char) (0x80 | ((c >> 6) & 0x3F));
+            encoded[2] = (char) (0x80 | (c & 0x3F));
+            n = 3;
+        } else {
+            encoded[0] = (char) (0xF0 | (c >> 18));
+            encoded[1] = (char) (0x80 | ((c >> 12) & 0x3F));
+            encoded[2] = (char) (0x80 | ((c >> 6) & 0x3F));
+            encoded[3] = (char) (0x80 | (c & 0x3F));
+            n = 4;
+        }
+        if (out + n > destSize - 1) {
+            break;
+        }
+        memcpy(dest + out, encoded, n);
+        out += n;
+    }
+    dest[out] = '\0';
+}
+
+// Pull the VolumeID, LocalBasePath, network share and suffix out of a LinkInfo structure
+void parseLinkInfo(const unsigned char* linkInfo, unsigned int linkInfoSize, LnkInfo* info) {
+    if (linkInfoSize < 28) {
+        return;
+    }
+    unsigned int linkInfoFlags = readU32(linkInfo + 8);
+
+    if (linkInfoFlags & LINK_INFO_VOLUME_ID) {
+        unsigned int volumeOffset = readU32(linkInfo + 12);
+        unsigned int basePathOffset = readU32(linkInfo + 16);
+
+        // VolumeID: size, DriveType, DriveSerialNumber, VolumeLabelOffset
+        if (volumeOffset < linkInfoSize && linkInfoSize - volumeOffset >= 16) {
+            const unsigned char* volume = linkInfo + volumeOffset;
+            info->driveType = readU32(volume + 4);
+            info->driveSerial = readU32(volume + 8);
+            unsigned int labelOffset = readU32(volume + 12);
+            if (labelOffset < linkInfoSize - volumeOffset) {
+                copyAnsiString(info->volumeLabel, sizeof(info->volumeLabel), linkInfo, volumeOffset + labelOffset, linkInfoSize);
+            }
+        }
+        copyAnsiString(info->localBasePath, sizeof(info->localBasePath), linkInfo, basePathOffset, linkInfoSize);
+    }
+
+    // CommonNetworkRelativeLink: size, flags, NetNameOffset, DeviceNameOffset
+    if (linkInfoFlags & LINK_INFO_NETWORK) {
+        unsigned int networkOffset = readU32(linkInfo + 20);
+        if (networkOffset < linkInfoSize && linkInfoSize - networkOffset >= 20) {
+            const unsigned char* network = linkInfo + networkOffset;
+            unsigned int networkSize = linkInfoSize - networkOffset;
+            unsigned int netNameOffset = readU32(network + 8);
+            unsigned int deviceNameOffset = readU32(network + 12);
+            copyAnsiString(info->netName, sizeof(info->netName), network, netNameOffset, networkSize);
+            if (deviceNameOffset) {
+                copyAnsiString(info->deviceName, sizeof(info->deviceName), network, deviceNameOffset, networkSize);
+            }
+        }
+    }
+
+    copyAnsiString(info->commonPathSuffix, sizeof(info->commonPathSuffix), linkInfo, readU32(linkInfo + 24), linkInfoSize);
+}
+
+// Append one path component, Windows style, to a path being rebuilt
+void appendPathComponent(char* path, int size, const char* component) {
+    int length = (int) strlen(path);
+    if (length && path[length - 1] != '\\' && length < size - 1) {
+        path[length++] = '\\';
+        path[length] = '\0';
+    }
+    snprintf(path + length, size - length, "%s", component);
+}
+
+// Name of a shell item: the drive of a volume item, or the long name of a file entry item.
+// Returns 0 for items that do not contribute to a file system path (e.g. "My Computer").
+int shellItemName(const unsigned char* item, unsigned int itemSize, char* name, int nameSize) {
+    name[0] = '\0';
+    if (itemSize < 3) {
+        return 0;
+    }
+    unsigned int type = item[2];
+
+    // Volume item, "C:\"
+    if ((type & 0x70) == 0x20) {
+        copyAnsiString(name, nameSize, item, 3, itemSize);
+        int length = (int) strlen(name);
+        if (length && name[length - 1] == '\\') {
+            name[length - 1] = '\0';
+        }
+        return name[0] != '\0';
+    }
+
+    // File entry item: size, DOS time and attributes, then the primary (short) name
+    if ((type & 0x70) != 0x30 || itemSize < 15) {
+        return 0;
+    }
+    if (type & 0x04) {
+        copyUtf16String(name, nameSize, item + 14, (itemSize - 14) / 2);
+    } else {
+        copyAnsiString(name, nameSize, item, 14, itemSize);
+    }
+
+    // The 0xBEEF0004 extension block, found through the item's last two bytes, holds the long name
+    unsigned int extOffset = readU16(item + itemSize - 2);
+    if (extOffset < 14 || extOffset + 18 > itemSize || readU32(item + extOffset + 4) != 0xBEEF0004) {
+        return 1;
+    }
+    const unsigned char* ext = item + extOffset;
+    unsigned int extSize = readU16(ext);
+    unsigned int version = readU16(ext + 2);
+    unsigned int nameOffset = 18;
+    if (version >= 7) {
+        nameOffset += 18;
+    }
+    nameOffset += 2;
+    if (version >= 9) {
+        nameOffset += 4;
+    }
+    if (version >= 8) {
+        nameOffset += 4;
+    }
+    if (extSize <= itemSize - extOffset && nameOffset + 2 <= extSize) {
+        copyUtf16String(name, nameSize, ext + nameOffset, (extSize - nameOffset) / 2);
+    }
+    return 1;
+}
+
+// Rebuild a Windows path from the IDList. When knownFolderOffset is set, the items
+// from that offset on are also collected as the path below the known folder.
+void parseIdList(const unsigned char* idList, unsigned int idListSize, LnkInfo* info, unsigned int knownFolderOffset) {
+    unsigned int offset = 0;
+    char name[MAX_PATH_LEN];
+
+    while (offset + 2 <= idListSize) {
+        unsigned int itemSize = readU16(idList + offset);
+        if (itemSize < 2 || itemSize > idListSize - offset) {
+            break;   // TerminalID or a truncated item
+        }
+        if (shellItemName(idList + offset, itemSize, name, sizeof(name))) {
+            appendPathComponent(info->idListPath, sizeof(info->idListPath), name);
+            if (info->hasKnownFolder && offset >= knownFolderOffset) {
+                appendPathComponent(info->knownFolderSubPath, sizeof(info->knownFolderSubPath), name);
+            }
+        }
+        offset += itemSize;
+    }
+
+    // A path without a drive (e.g. only a known folder child) is no use on its own
+    if (!(isalpha((unsigned char) info->idListPath[0]) && info->idListPath[1] == ':')) {
+        info->idListPath[0] = '\0';
+    }
+}
+
+// Parse the ShellLinkHeader, LinkInfo and StringData structures (MS-SHLLINK).
+// Returns 1 when the data is a shortcut; fields that are absent stay zeroed.
+int parseLnk(const unsigned char* data, int length, LnkInfo* info) {
+    static const unsigned char linkClsid[16] = {
+        0x01, 0x14, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x46
+    };
+    memset(info, 0, sizeof(*info));
+
+    if (length < LNK_HEADER_SIZE || readU32(data) != LNK_HEADER_SIZE || memcmp(data + 4, linkClsid, 16) != 0) {
+        return 0;
+    }
+    info->valid = 1;
+    info->linkFlags = readU32(data + 20);
+    info->writeTime = readU32(data + 44) | ((unsigned long long) readU32(data + 48) << 32);
+    info->fileSize = readU32(data + 52);
+    info->iconIndex = (int) readU32(data + 56);
+
+    unsigned int offset = LNK_HEADER_SIZE;
+
+    // The LinkTargetIDList is prefixed by its own size. It is walked once
+    // ExtraData has told us where a known folder starts in it.
+    const unsigned char* idList = NULL;
+    unsigned int idListSize = 0;
+    if (info->linkFlags & LNK_HAS_ID_LIST) {
+        if (offset + 2 > (unsigned int) length) {
+            return 1;
+        }
+        idListSize = readU16(data + offset);
+        if (idListSize > length - offset - 2) {
+            return 1;
+        }
+        idList = data + offset + 2;
+        offset += 2 + idListSize;
+    }
+
+    // LinkInfo is prefixed by its own size as well. Once a structure is
+    // truncated nothing after it can be located, but the IDList is still used.
+    if (info->linkFlags & LNK_HAS_LINK_INFO) {
+        unsigned int linkInfoSize = offset + 4 <= (unsigned int) length ? readU32(data + offset) : 0;
+        if (linkInfoSize >= 4 && linkInfoSize <= length - offset) {
+            parseLinkInfo(data + offset, linkInfoSize, info);
+            offset += linkInfoSize;
+        } else {
+            offset = length;
+        }
+    }
+
+    // StringData: counted strings in a fixed order, each present only when its flag is set
+    static const unsigned int stringFlags[] = {
+        LNK_HAS_NAME, LNK_HAS_RELATIVE_PATH, LNK_HAS_WORKING_DIR, LNK_HAS_ARGUMENTS, LNK_HAS_ICON_LOCATION
+    };
+    int isUnicode = (info->linkFlags & LNK_IS_UNICODE) != 0;
+    for (int i = 0; i < 5; i++) {
+        if (!(info->linkFlags & stringFlags[i])) {
+            continue;
+        }
+        if (offset + 2 > (unsigned int) length) {
+            offset = length;
+            break;
+        }
+        unsigned int count = readU16(data + offset);
+        unsigned int bytes = isUnicode ? count * 2 : count;
+        offset += 2;
+        if (bytes > length - offset) {
+            offset = length;
+            break;
+        }
+
+        char* dest = stringFlags[i] == LNK_HAS_RELATIVE_PATH ? info->relativePath
+            : stringFlags[i] == LNK_HAS_ICON_LOCATION ? info->iconLocation : NULL;
+        if (dest && isUnicode) {
+            copyUtf16String(dest, MAX_PATH_LEN, data + offset, count);
+        } else if (dest) {
+            copyAnsiString(dest, MAX_PATH_LEN, data + offset, 0, count);
+        }
+        offset += bytes;
+    }
+
+    // ExtraData: blocks of size and signature, closed by a block smaller than 4 bytes
+    unsigned int knownFolderOffset = 0;
+    while (offset + 8 <= (unsigned int) length) {
+        unsigned int blockSize = readU32(data + offset);
+        if (blockSize < 8 || blockSize > length - offset) {
+            break;
+        }
+        const unsigned char* block = data + offset;
+        unsigned int signature = readU32(block + 4);
+
+        if (signature == EXTRA_ENVIRONMENT_BLOCK && blockSize >= 0x314) {
+            // TargetUnicode when it is set, TargetAnsi otherwise
+            copyUtf16String(info->environmentPath, sizeof(info->environmentPath), block + 268, 260);
+            if (!info->environmentPath[0]) {
+                copyAnsiString(info->environmentPath, sizeof(info->environmentPath), block, 8, 268);
+            }
+        } else if (signature == EXTRA_ICON_ENVIRONMENT_BLOCK && blockSize >= 0x314 && !info->iconLocation[0]) {
+            // Same layout as the environment block, used when StringData has no icon
+            copyUtf16String(info->iconLocation, sizeof(info->iconLocation), block + 268, 260);
+            if (!info->iconLocation[0]) {
+                copyAnsiString(info->iconLocation, sizeof(info->iconLocation), block, 8, 268);
+            }
+        } else if (signature == EXTRA_KNOWN_FOLDER_BLOCK && blockSize >= 0x1C) {
+            memcpy(info->knownFolderId, block + 8, 16);
+            knownFolderOffset = readU32(block + 24);
+            info->hasKnownFolder = 1;
+        }
+        offset += blockSize;
+    }
+
+    if (idList) {
+        parseIdList(idList, idListSize, info, knownFolderOffset);
+    }
+    return 1;
+}
+
+// The absolute target recorded in LinkInfo: LocalBasePath, or the mapped network
+// drive, followed by CommonPathSuffix. NULL when LinkInfo holds neither.
+char* buildLinkInfoPath(const LnkInfo* info) {
+    const char* base = info->localBasePath[0] ? info->localBasePath : info->deviceName;
+    if (!base[0]) {
+        return NULL;
+    }
+
+    char path[MAX_PATH_LEN];
+    snprintf(path, sizeof(path), "%s", base);
+    if (info->commonPathSuffix[0]) {
+        appendPathComponent(path, sizeof(path), info->commonPathSuffix);
+    }
+    return strdup(path);
+}
+
+// FILETIME counts 100 ns from 1601
+long long filetimeToUnix(unsigned long long filetime) {
+    return (long long) (filetime / 10000000) - 11644473600LL;
+}
+
+// The target a shortcut recorded, as it was on the machine that made it: LinkInfo,
+// then the IDList, the environment block and the relative path. NULL when none.
+char* recordedTarget(const LnkInfo* info) {
+    char* linkInfoPath = buildLinkInfoPath(info);
+    if (linkInfoPath) {
+        return linkInfoPath;
+    }
+    const char* target = info->idListPath[0] ? info->idListPath
+        : info->environmentPath[0] ? info->environmentPath
+        : info->relativePath;
+    return target[0] ? strdup(target) : NULL;
+}
@@ -68,198 +68,134 @@ _ _  _ ____ ___ ____ _    _    ____ ___ _ ____ _  _
     
  */ 
 
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <regex.h>
-#include <sys/utsname.h>
-#include <dirent.h>
-#include <unistd.h>
+#include "lnkInternal.h"
 
-
-/*
-___  ____ _ _ _ ____ ____    ___  _    ____ _  _ ___
-|__] |  | | | | |___ |__/    |__] |    |__| |\ |  |
-|    |__| |_|_| |___ |  \    |    |___ |  | | \|  |
-                
-
-#OPENING | https://www.youtube.com/watch?v=_85LaeTCtV8 :3
-
-*/
-
-
-#define MAX_DATA_SIZE 4096
-
-
-// Global variable to hold the notification command
-char notifyCmdFormat[256] = {0};
-
-// Convert binary data to ASCII representation
-char* binaryToASCII(const unsigned char* data, int length) {
-    char* asciiStr = (char*) malloc(length + 1);
-    if (!asciiStr) {
-        perror("Failed to allocate memory for asciiStr");
-        exit(1);
+int main(int argc, char* argv[]) {
+    // Detect the OS and set up the notification command format if not set already
+    if (!notifyCmdFormat[0]) {
+        struct utsname sysinfo;
+        uname(&sysinfo);
+        if (strcmp(sysinfo.sysname, "Linux") == 0) {
+            strcpy(notifyCmdFormat, "notify-send 'Error' '%s'");
+        } else if (strcmp(sysinfo.sysname, "Darwin") == 0) {
+            strcpy(notifyCmdFormat, "osascript -e 'display notification \"%s\" with title \"Error\"'");
+        }
     }
 
-    for (int i = 0; i < length; i++) {
-        asciiStr[i] = (data[i] >= 32 && data[i] <= 126) || data[i] == '\n' || data[i] == '\t' ? data[i] : ' ';
+    // Options come first, before --resolve or the shortcut
+    while (argc >= 3) {
+        if (strcmp(argv[1], "--resume") == 0) {
+            resumeScan = 1;
+            argv[1] = argv[0];
+            argv++;
+            argc--;
+            continue;
+        } else if (strcmp(argv[1], "--metrics-file") == 0) {
+            snprintf(metricsFile, sizeof(metricsFile), "%s", argv[2]);
+        } else if (strcmp(argv[1], "--shard") == 0) {
+            if (sscanf(argv[2], "%d/%d", &shardIndex, &shardCount) != 2 || shardCount < 1 || shardIndex < 0 || shardIndex >= shardCount) {
+                fprintf(stderr, "--shard expects i/N with 0 <= i < N\n");
+                return 1;
+            }
+        } else if (strcmp(argv[1], "--checkpoint") == 0) {
+            snprintf(checkpointFile, sizeof(checkpointFile), "%s", argv[2]);
+        } else if (strcmp(argv[1], "--shard-depth") == 0) {
+            shardDepth = atoi(argv[2]);
+        } else if (strcmp(argv[1], "--metrics-socket") == 0) {
+            snprintf(metricsSocket, sizeof(metricsSocket), "%s", argv[2]);
+#ifdef LNK_ALLOC_STATS
+        // --alloc-steady N: in bulk mode, abort on any allocation after the first N shortcuts
+        } else if (strcmp(argv[1], "--alloc-steady") == 0) {
+            allocWarmupFiles = atoi(argv[2]);
+#endif
+        } else {
+            break;
+        }
+        argv[2] = argv[0];
+        argv += 2;
+        argc -= 2;
     }
-    asciiStr[length] = '\0';
-    return asciiStr;
-}
-
-// Display an error message using the appropriate method for the current OS
-void showError(const char* message) {
-    if (!notifyCmdFormat[0]) {
-        printf("Unknown OS. Cannot display notification.\n");
-        return;
+    startMetrics();
+#ifdef LNK_ALLOC_STATS
+    atexit(printAllocSummary);
+#endif
+
+    // Bulk mode prints targets instead of opening them
+    if (argc >= 2 && strcmp(argv[1], "--resolve") == 0) {
+        initLog(LOG_WARN);
+        loadDriveMap();
+        return resolveBulk(argc - 2, argv + 2);
     }
 
-    char cmd[1024];
-    sprintf(cmd, notifyCmdFormat, message);
-    system(cmd);
-}
-
-char* findLongestValidPath(const char* str) {
-    regex_t regex;
-    regmatch_t matches[2];
-    // Regular expression pattern to match file paths
-    char pattern[] = "([A-Za-z]:[\\\\/][^ ]+( [^ ]+)*[^ ]*)";
-    char* longestPath = NULL;
-    int longestPathLen = 0;
-
-    // Compile the regular expression
-    if (regcomp(&regex, pattern, REG_EXTENDED)) {
-        showError("Failed to compile regex.");
-        return NULL;
+    // Scan modes walk whole trees, --merge joins the sorted outputs of several scans
+    if (argc >= 2 && strcmp(argv[1], "--scan") == 0) {
+        initLog(LOG_WARN);
+        loadDriveMap();
+        return scanResolve(argc - 2, argv + 2);
     }
-
-    const char* currentSearch = str;
-    // Search for matches repeatedly, aiming to find the longest match
-    while (!regexec(&regex, currentSearch, 2, matches, 0)) {
-        int start = matches[1].rm_so;
-        int end = matches[1].rm_eo;
-        int currentMatchLen = end - start;
-
-        // Check if the current match is longer than the previously found path
-        if (currentMatchLen > longestPathLen) {
-            free(longestPath);
-            longestPath = malloc(currentMatchLen + 1);
-            strncpy(longestPath, currentSearch + start, currentMatchLen);
-            longestPath[currentMatchLen] = '\0';
-            longestPathLen = currentMatchLen;
-        }
-        // Move the search starting point after the current match
-        currentSearch += end;
+    if (argc >= 2 && strcmp(argv[1], "--merge") == 0) {
+        initLog(LOG_WARN);
+        return mergeOutputs(argc - 2, argv + 2);
     }
-
-    // Free up the memory used by the regex
-    regfree(&regex);
-    return longestPath;
-}
-
-char* findMountedPath(char* foundPath) {
-    // Open the /proc/mounts file which lists all mounted filesystems on Linux
-    FILE *mounts = fopen("/proc/mounts", "r");
-    if (!mounts) {
-        perror("Failed to open /proc/mounts");
-        return NULL;
+    if (argc == 4 && strcmp(argv[1], "--diff") == 0) {
+        initLog(LOG_WARN);
+        return diffOutputs(argv[2], argv[3]);
     }
-
-    // Define buffers to hold values from each line in /proc/mounts
-    char device[256], mountpoint[256], rest[512];
-
-    // Extract the core part of the path without the drive letter (e.g., skip 'G:')
-    char* corePath = foundPath + 2;
-
-    // Loop through each line in /proc/mounts
-    while (fscanf(mounts, "%s %s %s\n", device, mountpoint, rest) != EOF) {
-        char potentialPath[1024];
-
-        // Create a potential path by appending the corePath to the current mountpoint.
-        sprintf(potentialPath, "%s%s", mountpoint, corePath);
-
-        printf("Trying potential path: %s\n", potentialPath);
-
-        // Check if the generated potential path exists in the filesystem
-        if (access(potentialPath, F_OK) == 0) {
-            printf("Found valid path: %s\n", potentialPath);
-            fclose(mounts);
-            return strdup(potentialPath);
+    if (argc == 3 && strcmp(argv[1], "--carve") == 0) {
+        initLog(LOG_WARN);
+        return carveFile(argv[2]);
+    }
+    if (argc >= 2 && strcmp(argv[1], "--jumplist") == 0) {
+        initLog(LOG_WARN);
+        return readJumpLists(argc - 2, argv + 2);
+    }
+    if (argc == 3 && strcmp(argv[1], "--archive") == 0) {
+        initLog(LOG_WARN);
+        loadDriveMap();
+        return resolveArchive(argv[2]);
+    }
+    if (argc == 2 && strcmp(argv[1], "--stdin-stream") == 0) {
+        // After lnkInit(), which keeps a library quiet
+        lnkInit();
+        initLog(LOG_WARN);
+        return resolveStdinStream();
+    }
+    if ((argc == 2 || argc == 3) && strcmp(argv[1], "--coproc") == 0) {
+        int workers = argc == 3 ? atoi(argv[2]) : COPROC_WORKERS;
+        if (workers < 1 || workers > COPROC_MAX_WORKERS) {
+            fprintf(stderr, "--coproc takes 1 to %d workers\n", COPROC_MAX_WORKERS);
+            return 1;
         }
+        initLog(LOG_WARN);
+        loadDriveMap();
+        return runCoproc(workers);
+    }
+    // Scan mode aggregates whole trees of shortcuts into one summary
+    if (argc >= 2 && strcmp(argv[1], "--stats") == 0) {
+        initLog(LOG_WARN);
+        loadDriveMap();
+        return scanStats(argc - 2, argv + 2);
     }
 
-    fclose(mounts);
-    return NULL;
-}
-
-
-/*
-___  ____ ____ ____ ____ ____ ____ 
-|__] |__/ |  | |    |___ [__  [__  
-|    |  \ |__| |___ |___ ___] ___] 
-
-*/
-
-int main(int argc, char* argv[]) {
     // Check if the correct number of arguments are passed to the program
     if (argc != 2) {
         showError("Incorrect number of arguments.");
         return 1;
     }
 
-    // Open the .lnk file for reading in binary mode
-    FILE* file = fopen(argv[1], "rb");
-    if (!file) {
-        showError("Error opening the .lnk file.");
-        return 1;
-    }
-
-    unsigned char data[MAX_DATA_SIZE];
-    
-    // Read the contents of the .lnk file into the data buffer
-    int bytesRead = fread(data, 1, MAX_DATA_SIZE, file);
-    
-    // Close the file as it's no longer needed
-    fclose(file);
-
-    // Convert the binary data to ASCII representation
-    char* asciiData = binaryToASCII(data, bytesRead);
+    initLog(LOG_INFO);
 
-    // Extract the longest valid file path from the ASCII data
-    char* foundPath = findLongestValidPath(asciiData);
+    // Load the explicit drive letter mappings (config file, Wine, /mnt/<letter>)
+    loadDriveMap();
 
-    // Detect the OS and set up the notification command format if not set already
-    if (!notifyCmdFormat[0]) {
-        struct utsname sysinfo;
-        uname(&sysinfo);
-        if (strcmp(sysinfo.sysname, "Linux") == 0) {
-            strcpy(notifyCmdFormat, "notify-send 'Error' '%s'");
-        } else if (strcmp(sysinfo.sysname, "Darwin") == 0) {
-            strcpy(notifyCmdFormat, "osascript -e 'display notification \"%s\" with title \"Error\"'");
-        }
+    char* foundPath;
+    LnkInfo info;
+    if (resolveLnkFile(argv[1], &foundPath, &info) == RESULT_UNREADABLE) {
+        showError("Error opening the .lnk file.");
+        return 1;
     }
 
-    // If a path is found within the .lnk file
     if (foundPath) {
-        // Convert any backslashes to forward slashes
-        for (int i = 0; foundPath[i]; i++) {
-            if (foundPath[i] == '\\') {
-                foundPath[i] = '/';
-            }
-        } 
-
-        // Check if the extracted path exists in the filesystem
-        if (access(foundPath, F_OK) != 0) {
-            // If not, attempt to find a corresponding mounted path
-            char* actualPath = findMountedPath(foundPath);
-            if (actualPath) {
-                free(foundPath);
-                foundPath = actualPath;
-            }
-        }
-
         char cmd[1024];
         
         // Determine if the path represents a directory or file based on the presence of an extension
@@ -270,7 +206,11 @@ int main(int argc, char* argv[]) {
         }
 
         // Try to open the extracted path using the OS default program
-        if (system(cmd) != 0) {
+        flushLog();
+        int launched = system(cmd);
+        TRACE(launch, foundPath, launched);
+        if (launched != 0) {
+            atomic_fetch_add(&launchFailuresTotal, 1);
             char errMsg[512];
             sprintf(errMsg, "Error opening path: %s", foundPath);
             showError(errMsg);
@@ -290,7 +230,5 @@ int main(int argc, char* argv[]) {
         showError("Path not found in the provided .lnk file.");
     }
 
-    // Free the memory allocated for the ASCII representation
-    free(asciiData);
     return 0;
 }
@@ -0,0 +1,37 @@
+// open_lnk as a library: resolve shortcuts that are already in memory, such as
+// mail attachments, without writing them to a file first.
+//
+//   gcc -c -O2 -pthread lnkLog.c lnkMetrics.c lnkParse.c lnkResolve.c
+//   gcc scanner.c lnkLog.o lnkMetrics.o lnkParse.o lnkResolve.o -o scanner -pthread
+//
+// Every function may be called from several threads at once.
+
+#ifndef LNK_READER_H
+#define LNK_READER_H
+
+#include <stddef.h>
+
+// Outcome of resolving one shortcut
+enum {
+    RESULT_FOUND,           // The target exists on this machine
+    RESULT_MISSING,         // A path was extracted but nothing exists for it
+    RESULT_NO_PATH,         // The shortcut holds no usable path
+    RESULT_UNREADABLE       // The .lnk itself could not be read
+};
+
+// Load the drive mappings. The functions below call it on first use.
+void lnkInit(void);
+
+// Resolve a shortcut held in memory as if it were a file. name is used in logs
+// and as the folder a relative target starts from, NULL for none. *targetPath
+// receives the path found, else the path the shortcut records, else NULL; free() it.
+int lnkResolveBuffer(const void* data, size_t length, const char* name, char** targetPath);
+
+// The target the shortcut recorded on the machine that made it, without looking
+// for it here. NULL when data is not a shortcut or holds no path; free() it.
+char* lnkRecordedTarget(const void* data, size_t length);
+
+// "found", "missing", "no_path" or "unreadable"
+const char* lnkResultName(int result);
+
+#endif
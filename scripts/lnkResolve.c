@@ -0,0 +1,1846 @@
+// Finding the target of a shortcut on this machine: drive mappings, the mount
+// table, the directory memo and negative cache on top of it, the resolution
+// strategies, and the library calls of lnkReader.h
+
+#include "lnkInternal.h"
+
+// openat2() confines a lookup to one mount (Linux 5.6+)
+#if defined(__linux__) && defined(SYS_openat2) && __has_include(<linux/openat2.h>)
+#include <linux/openat2.h>
+#define HAVE_OPENAT2 1
+#endif
+
+
+/*
+___  ____ _ _ _ ____ ____    ___  _    ____ _  _ ___
+|__] |  | | | | |___ |__/    |__] |    |__| |\ |  |
+|    |__| |_|_| |___ |  \    |    |___ |  | | \|  |
+                
+
+#OPENING | https://www.youtube.com/watch?v=_85LaeTCtV8 :3
+
+*/
+
+
+#define MAX_DRIVE_CACHE 64
+#define NEGATIVE_CACHE_SIZE 4096
+#define PATH_MEMO_SIZE 2048
+#define PATH_MEMO_TTL_US 1000000
+#define CHECK_OFFSET 0x84222325cbf29ce4ULL
+
+// One line of /proc/mounts
+typedef struct {
+    char device[256];
+    char mountpoint[MAX_PATH_LEN];
+    char fsType[64];
+    atomic_int rootFd;                  // Descriptor of the mount root, -1 unopened, -2 unusable
+} MountEntry;
+
+// A drive letter we have already seen resolve to a mountpoint
+typedef struct {
+    char letter;
+    unsigned int serial;
+    char label[64];
+    char mountpoint[MAX_PATH_LEN];
+} DriveMapping;
+
+// Learned drive letter -> mountpoint table, persisted between runs
+DriveMapping driveCache[MAX_DRIVE_CACHE];
+int driveCacheCount = 0;
+int driveCacheLoaded = 0;
+int driveCacheDirty = 0;
+pthread_mutex_t driveCacheLock = PTHREAD_MUTEX_INITIALIZER;
+
+// Explicit drive letter -> directory table, indexed by letter - 'A'
+char driveMap[26][MAX_PATH_LEN];
+
+// Snapshot of /proc/mounts, reloaded only when the kernel reports a change.
+// Each reload starts a new epoch for the caches built on top of it.
+MountEntry* mountTable = NULL;
+int mountCount = 0;
+int mountCapacity = 0;
+int mountTableLoaded = 0;
+unsigned long long mountTableHash = 0;
+int mountsWatchFd = -1;
+pthread_rwlock_t mountTableLock = PTHREAD_RWLOCK_INITIALIZER;
+pthread_mutex_t mountReloadLock = PTHREAD_MUTEX_INITIALIZER;
+
+// Cleared when openat2() turns out to be unavailable (old kernel, seccomp)
+atomic_int openat2Usable = 1;
+
+// A path fingerprinted twice: hash picks the slot of the memo and negative
+// cache tables, check and length confirm the entry, so two paths colliding on
+// one hash are still told apart. 0 hash marks a free slot.
+typedef struct {
+    unsigned long long hash;
+    unsigned long long check;
+    unsigned int length;
+} PathKey;
+
+// Directory memo: key of a directory path -> descriptor of that directory.
+// Entries expire after PATH_MEMO_TTL_US so a renamed directory is reopened, and
+// the least recently used one is closed when the memo is full. An entry is
+// never closed while a lookup holds it (users).
+typedef struct {
+    PathKey key;
+    int fd;
+    int users;
+    long long opened;
+    unsigned long long lastUsed;
+} PathMemoEntry;
+
+PathMemoEntry pathMemo[PATH_MEMO_SIZE];
+int pathMemoCount = 0;
+int pathMemoLimit = 0;
+unsigned long long pathMemoClock = 0;
+int rootDirFd = -1;
+pthread_mutex_t pathMemoLock = PTHREAD_MUTEX_INITIALIZER;
+
+// Keys of volumes and top directories of mounts known to be missing during this mount epoch
+PathKey negativeCache[NEGATIVE_CACHE_SIZE];
+int negativeCacheCount = 0;
+pthread_mutex_t negativeCacheLock = PTHREAD_MUTEX_INITIALIZER;
+
+// Names of the RESULT_* outcomes of lnkReader.h
+const char* resultNames[] = {"found", "missing", "no_path", "unreadable"};
+
+// Record an explicit mapping unless a higher priority source already set that letter
+void setDriveMapping(char letter, const char* path) {
+    letter = (char) toupper((unsigned char) letter);
+    if (letter < 'A' || letter > 'Z' || driveMap[letter - 'A'][0] || !path[0]) {
+        return;
+    }
+
+    // Store without a trailing slash, the core path brings its own
+    int length = (int) strlen(path);
+    while (length > 1 && path[length - 1] == '/') {
+        length--;
+    }
+    snprintf(driveMap[letter - 'A'], MAX_PATH_LEN, "%.*s", length, path);
+}
+
+// Read "G: /media/user/DATA" lines from $XDG_CONFIG_HOME/open_lnk/drives.conf
+void loadDriveConfig(void) {
+    const char* configHome = getenv("XDG_CONFIG_HOME");
+    const char* home = getenv("HOME");
+    char path[MAX_PATH_LEN];
+
+    if (configHome && configHome[0]) {
+        snprintf(path, sizeof(path), "%s/open_lnk/drives.conf", configHome);
+    } else if (home && home[0]) {
+        snprintf(path, sizeof(path), "%s/.config/open_lnk/drives.conf", home);
+    } else {
+        return;
+    }
+
+    FILE* config = fopen(path, "r");
+    if (!config) {
+        return;
+    }
+
+    char line[MAX_PATH_LEN + 16];
+    while (fgets(line, sizeof(line), config)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        char* p = line;
+        while (isspace((unsigned char) *p)) {
+            p++;
+        }
+        if (!isalpha((unsigned char) p[0]) || p[1] != ':') {
+            continue;   // Comments and malformed lines
+        }
+
+        char* target = p + 2;
+        while (isspace((unsigned char) *target)) {
+            target++;
+        }
+        setDriveMapping(p[0], target);
+    }
+    fclose(config);
+}
+
+// Wine keeps one "<x>:" symlink per drive in $WINEPREFIX/dosdevices
+void loadWineDrives(void) {
+    const char* prefix = getenv("WINEPREFIX");
+    const char* home = getenv("HOME");
+    char dirPath[MAX_PATH_LEN];
+
+    if (prefix && prefix[0]) {
+        snprintf(dirPath, sizeof(dirPath), "%s/dosdevices", prefix);
+    } else if (home && home[0]) {
+        snprintf(dirPath, sizeof(dirPath), "%s/.wine/dosdevices", home);
+    } else {
+        return;
+    }
+
+    DIR* dir = opendir(dirPath);
+    if (!dir) {
+        return;
+    }
+
+    struct dirent* entry;
+    while ((entry = readdir(dir))) {
+        const char* name = entry->d_name;
+        if (!isalpha((unsigned char) name[0]) || name[1] != ':' || name[2]) {
+            continue;   // Skips "c::" raw device links as well
+        }
+
+        char linkPath[MAX_PATH_LEN * 2], resolved[PATH_MAX];
+        snprintf(linkPath, sizeof(linkPath), "%s/%s", dirPath, name);
+        if (realpath(linkPath, resolved)) {
+            setDriveMapping(name[0], resolved);
+        }
+    }
+    closedir(dir);
+}
+
+// WSL (and some hand-made setups) mount drives as /mnt/<letter>
+void loadMntDrives(void) {
+    DIR* dir = opendir("/mnt");
+    if (!dir) {
+        return;
+    }
+
+    struct dirent* entry;
+    while ((entry = readdir(dir))) {
+        const char* name = entry->d_name;
+        if (isalpha((unsigned char) name[0]) && !name[1]) {
+            char path[8];
+            snprintf(path, sizeof(path), "/mnt/%c", name[0]);
+            setDriveMapping(name[0], path);
+        }
+    }
+    closedir(dir);
+}
+
+// Build the drive table once at startup. The config file wins over Wine, Wine over /mnt.
+void loadDriveMap(void) {
+    loadDriveConfig();
+    loadWineDrives();
+    loadMntDrives();
+}
+
+// /proc/mounts escapes spaces, tabs and backslashes in mountpoints as octal (\040)
+void unescapeMountPath(char* path) {
+    char* out = path;
+    for (char* in = path; *in; in++) {
+        if (in[0] == '\\' && in[1] >= '0' && in[1] <= '7' && in[2] >= '0' && in[2] <= '7' && in[3] >= '0' && in[3] <= '7') {
+            *out++ = (char) ((in[1] - '0') * 64 + (in[2] - '0') * 8 + (in[3] - '0'));
+            in += 3;
+        } else {
+            *out++ = *in;
+        }
+    }
+    *out = '\0';
+}
+
+// FNV-1a, used to fingerprint the mount table
+unsigned long long hashBytes(unsigned long long hash, const char* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char) data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// Second fingerprint of a path key, mixed unlike FNV so both rarely collide together
+unsigned long long checkBytes(unsigned long long check, const char* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        check = (check + (unsigned char) data[i]) * 0x9e3779b97f4a7c15ULL;
+        check ^= check >> 29;
+    }
+    return check;
+}
+
+PathKey pathKey(const char* text, size_t length) {
+    PathKey key = {hashBytes(FNV_OFFSET, text, length) | 1, checkBytes(CHECK_OFFSET, text, length), (unsigned int) length};
+    return key;
+}
+
+// Key of parent + "/" + name, built from the parent's without rehashing it
+PathKey childPathKey(PathKey parent, const char* name, size_t length) {
+    PathKey key;
+    key.hash = hashBytes(hashBytes(parent.hash, "/", 1), name, length) | 1;
+    key.check = checkBytes(checkBytes(parent.check, "/", 1), name, length);
+    key.length = parent.length + 1 + (unsigned int) length;
+    return key;
+}
+
+int samePathKey(PathKey a, PathKey b) {
+    return a.hash == b.hash && a.check == b.check && a.length == b.length;
+}
+
+// Look a path up below an open directory instead of walking it again from "/".
+// With confine and openat2() the walk, symlinks included, cannot leave that mount.
+// st is filled in when given. Returns 1 when the path exists.
+int probeBelowMount(int rootFd, const char* relPath, struct stat* st, int confine) {
+    if (!relPath[0]) {
+        relPath = ".";
+    }
+
+#ifdef HAVE_OPENAT2
+    if (confine && atomic_load(&openat2Usable)) {
+        struct open_how how;
+        memset(&how, 0, sizeof(how));
+        how.flags = O_PATH | O_CLOEXEC;
+        how.resolve = RESOLVE_NO_XDEV;
+
+        int fd = (int) syscall(SYS_openat2, rootFd, relPath, &how, sizeof(how));
+        if (fd >= 0) {
+            int found = !st || fstat(fd, st) == 0;
+            close(fd);
+            return found;
+        }
+        if (errno != ENOSYS && errno != EPERM) {
+            return 0;
+        }
+        atomic_store(&openat2Usable, 0);
+    }
+#endif
+
+    if (st) {
+        return fstatat(rootFd, relPath, st, 0) == 0;
+    }
+    return faccessat(rootFd, relPath, F_OK, 0) == 0;
+}
+
+// Open one directory below dirFd, confined to its mount like probeBelowMount()
+int openDirBelow(int dirFd, const char* name, int confine) {
+#ifdef HAVE_OPENAT2
+    if (confine && atomic_load(&openat2Usable)) {
+        struct open_how how;
+        memset(&how, 0, sizeof(how));
+        how.flags = O_PATH | O_DIRECTORY | O_CLOEXEC;
+        how.resolve = RESOLVE_NO_XDEV;
+
+        int fd = (int) syscall(SYS_openat2, dirFd, name, &how, sizeof(how));
+        if (fd >= 0 || (errno != ENOSYS && errno != EPERM)) {
+            return fd;
+        }
+        atomic_store(&openat2Usable, 0);
+    }
+#else
+    (void) confine;
+#endif
+
+#ifdef O_PATH
+    return openat(dirFd, name, O_PATH | O_DIRECTORY | O_CLOEXEC);
+#else
+    return openat(dirFd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+#endif
+}
+
+void closeDirFd(int fd) {
+    close(fd);
+}
+
+const ResolverFs realResolverFs = {"/proc/mounts", 1, openDirBelow, probeBelowMount, closeDirFd};
+const ResolverFs* resolverFs = &realResolverFs;
+
+// Close the root descriptors opened during the current epoch
+void closeMountRoots(void) {
+    for (int i = 0; i < mountCount; i++) {
+        int fd = atomic_load(&mountTable[i].rootFd);
+        if (fd >= 0) {
+            resolverFs->closeDir(fd);
+        }
+    }
+}
+
+// Read the mount table into mountTable and fingerprint it
+int readMountTable(void) {
+    // Open the /proc/mounts file which lists all mounted filesystems on Linux
+    FILE *mounts = fopen(resolverFs->mountsPath, "r");
+    if (!mounts) {
+        perror("Failed to open the mount table");
+        return 0;
+    }
+
+    // Kept open only to be told about later mount changes
+    if (resolverFs->watchMounts && mountsWatchFd < 0) {
+        mountsWatchFd = open("/proc/self/mounts", O_RDONLY | O_CLOEXEC);
+    }
+
+    // Absolute lookups through the directory memo start here
+    if (rootDirFd < 0) {
+        rootDirFd = resolverFs->openDir(AT_FDCWD, "/", 0);
+    }
+
+    // Root descriptors belong to the previous table
+    closeMountRoots();
+
+    char line[2048];
+    mountCount = 0;
+    mountTableHash = FNV_OFFSET;
+    while (fgets(line, sizeof(line), mounts)) {
+        mountTableHash = hashBytes(mountTableHash, line, strlen(line));
+
+        // Grown by doubling, containers and automounters can list thousands of mounts
+        if (mountCount == mountCapacity) {
+            int capacity = mountCapacity ? mountCapacity * 2 : 64;
+            MountEntry* grown = realloc(mountTable, capacity * sizeof(MountEntry));
+            if (!grown) {
+                continue;
+            }
+            mountTable = grown;
+            mountCapacity = capacity;
+        }
+
+        MountEntry* entry = &mountTable[mountCount];
+        if (sscanf(line, "%255s %1023s %63s", entry->device, entry->mountpoint, entry->fsType) == 3) {
+            unescapeMountPath(entry->mountpoint);
+            atomic_init(&entry->rootFd, -1);
+            mountCount++;
+        }
+    }
+
+    fclose(mounts);
+    mountTableLoaded = 1;
+    return 1;
+}
+
+// /proc/self/mounts reports POLLPRI once per mount table change to whoever holds it open
+int mountTableChanged(void) {
+    if (!resolverFs->watchMounts || mountsWatchFd < 0) {
+        return 0;
+    }
+    struct pollfd watch = {mountsWatchFd, POLLPRI, 0};
+    return poll(&watch, 1, 0) > 0 && (watch.revents & (POLLPRI | POLLERR));
+}
+
+// Close every memoized directory. Only called under the mount table write lock,
+// when no lookup can be using them.
+void clearPathMemo(void) {
+    for (int i = 0; i < PATH_MEMO_SIZE; i++) {
+        if (pathMemo[i].key.hash) {
+            resolverFs->closeDir(pathMemo[i].fd);
+        }
+    }
+    memset(pathMemo, 0, sizeof(pathMemo));
+    pathMemoCount = 0;
+}
+
+// Forget every missing volume and prefix, they may exist in the new epoch
+void clearNegativeCache(void) {
+    pthread_mutex_lock(&negativeCacheLock);
+    memset(negativeCache, 0, sizeof(negativeCache));
+    negativeCacheCount = 0;
+    pthread_mutex_unlock(&negativeCacheLock);
+}
+
+// Take a read hold on the mount table, reloading it first when the mounts changed.
+// A reload drops the negative cache and makes the learned drive table recheck itself.
+int acquireMountTable(void) {
+    pthread_mutex_lock(&mountReloadLock);
+    if (!mountTableLoaded || mountTableChanged()) {
+        pthread_rwlock_wrlock(&mountTableLock);
+        int loaded = readMountTable();
+        clearPathMemo();
+        pthread_rwlock_unlock(&mountTableLock);
+        if (!loaded) {
+            pthread_mutex_unlock(&mountReloadLock);
+            return 0;
+        }
+
+        clearNegativeCache();
+        pthread_mutex_lock(&driveCacheLock);
+        driveCacheLoaded = 0;
+        pthread_mutex_unlock(&driveCacheLock);
+    }
+    pthread_rwlock_rdlock(&mountTableLock);
+    pthread_mutex_unlock(&mountReloadLock);
+    return 1;
+}
+
+void releaseMountTable(void) {
+    pthread_rwlock_unlock(&mountTableLock);
+}
+
+// Switch the mount table source and filesystem. Everything opened through the
+// previous one is closed, and the next lookup starts a fresh epoch.
+void setResolverFs(const ResolverFs* fs) {
+    pthread_mutex_lock(&mountReloadLock);
+    pthread_rwlock_wrlock(&mountTableLock);
+    closeMountRoots();
+    clearPathMemo();
+    if (rootDirFd >= 0) {
+        resolverFs->closeDir(rootDirFd);
+        rootDirFd = -1;
+    }
+    mountCount = 0;
+    mountTableLoaded = 0;
+    resolverFs = fs;
+    pthread_rwlock_unlock(&mountTableLock);
+
+    clearNegativeCache();
+    pthread_mutex_lock(&driveCacheLock);
+    driveCacheLoaded = 0;
+    pthread_mutex_unlock(&driveCacheLock);
+    pthread_mutex_unlock(&mountReloadLock);
+}
+
+// Open addressing over path keys
+int isKnownMissingKey(PathKey key) {
+    int found = 0;
+
+    pthread_mutex_lock(&negativeCacheLock);
+    for (unsigned int slot = key.hash % NEGATIVE_CACHE_SIZE; negativeCache[slot].hash; slot = (slot + 1) % NEGATIVE_CACHE_SIZE) {
+        if (samePathKey(negativeCache[slot], key)) {
+            found = 1;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&negativeCacheLock);
+    return found;
+}
+
+int isKnownMissing(const char* key) {
+    return isKnownMissingKey(pathKey(key, strlen(key)));
+}
+
+// Remember a missing volume or prefix, starting over when the table fills up
+void rememberMissingKey(PathKey key) {
+    pthread_mutex_lock(&negativeCacheLock);
+    if (negativeCacheCount >= NEGATIVE_CACHE_SIZE * 3 / 4) {
+        memset(negativeCache, 0, sizeof(negativeCache));
+        negativeCacheCount = 0;
+    }
+    unsigned int slot = key.hash % NEGATIVE_CACHE_SIZE;
+    while (negativeCache[slot].hash && !samePathKey(negativeCache[slot], key)) {
+        slot = (slot + 1) % NEGATIVE_CACHE_SIZE;
+    }
+    if (!negativeCache[slot].hash) {
+        negativeCache[slot] = key;
+        negativeCacheCount++;
+    }
+    pthread_mutex_unlock(&negativeCacheLock);
+}
+
+void rememberMissing(const char* key) {
+    rememberMissingKey(pathKey(key, strlen(key)));
+}
+
+// Descriptor of a mount root, opened on first use and kept for the epoch.
+// O_PATH only pins the directory, it does not read it.
+int mountRootFd(MountEntry* mount) {
+    int fd = atomic_load(&mount->rootFd);
+    if (fd != -1) {
+        return fd;
+    }
+
+    int opened = resolverFs->openDir(AT_FDCWD, mount->mountpoint, 0);
+    if (opened < 0) {
+        opened = -2;
+    }
+
+    // Another thread may have opened it meanwhile, keep theirs
+    int expected = -1;
+    if (!atomic_compare_exchange_strong(&mount->rootFd, &expected, opened)) {
+        if (opened >= 0) {
+            resolverFs->closeDir(opened);
+        }
+        return expected;
+    }
+    return opened;
+}
+
+// At most a quarter of the descriptor limit goes to the memo, the rest is left
+// to mount roots, shortcuts being read and whatever else the process opens
+int memoLimit(void) {
+    if (!pathMemoLimit) {
+        pathMemoLimit = PATH_MEMO_SIZE * 3 / 4;
+        struct rlimit limit;
+        if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY
+            && limit.rlim_cur / 4 < (rlim_t) pathMemoLimit) {
+            pathMemoLimit = limit.rlim_cur / 4 > 0 ? (int) (limit.rlim_cur / 4) : 1;
+        }
+    }
+    return pathMemoLimit;
+}
+
+int findMemoSlot(PathKey key) {
+    for (unsigned int slot = key.hash % PATH_MEMO_SIZE; pathMemo[slot].key.hash; slot = (slot + 1) % PATH_MEMO_SIZE) {
+        if (samePathKey(pathMemo[slot].key, key)) {
+            return slot;
+        }
+    }
+    return -1;
+}
+
+// Close an entry and shift the entries probed past it back into the hole
+void removeMemoSlot(unsigned int hole) {
+    resolverFs->closeDir(pathMemo[hole].fd);
+    pathMemoCount--;
+    for (unsigned int slot = (hole + 1) % PATH_MEMO_SIZE; pathMemo[slot].key.hash; slot = (slot + 1) % PATH_MEMO_SIZE) {
+        unsigned int home = pathMemo[slot].key.hash % PATH_MEMO_SIZE;
+        int reachable = hole < slot ? home > hole && home <= slot : home > hole || home <= slot;
+        if (!reachable) {
+            pathMemo[hole] = pathMemo[slot];
+            hole = slot;
+        }
+    }
+    memset(&pathMemo[hole], 0, sizeof(PathMemoEntry));
+}
+
+// Make room by closing the least recently used entry no lookup holds
+int evictMemoDir(void) {
+    int oldest = -1;
+    for (int slot = 0; slot < PATH_MEMO_SIZE; slot++) {
+        if (pathMemo[slot].key.hash && !pathMemo[slot].users
+            && (oldest < 0 || pathMemo[slot].lastUsed < pathMemo[oldest].lastUsed)) {
+            oldest = slot;
+        }
+    }
+    if (oldest < 0) {
+        return 0;
+    }
+    removeMemoSlot(oldest);
+    return 1;
+}
+
+// Descriptor of a memoized directory, held until releaseMemoDir(). An expired
+// entry is a miss, it is closed here unless another lookup still holds it.
+int findMemoDir(PathKey key) {
+    int fd = -1;
+    pthread_mutex_lock(&pathMemoLock);
+    int slot = findMemoSlot(key);
+    if (slot >= 0) {
+        PathMemoEntry* entry = &pathMemo[slot];
+        if (monotonicMicros() - entry->opened < PATH_MEMO_TTL_US) {
+            entry->users++;
+            entry->lastUsed = ++pathMemoClock;
+            fd = entry->fd;
+        } else if (!entry->users) {
+            removeMemoSlot(slot);
+        }
+    }
+    pthread_mutex_unlock(&pathMemoLock);
+    return fd;
+}
+
+void releaseMemoDir(PathKey key) {
+    pthread_mutex_lock(&pathMemoLock);
+    int slot = findMemoSlot(key);
+    if (slot >= 0) {
+        pathMemo[slot].users--;
+    }
+    pthread_mutex_unlock(&pathMemoLock);
+}
+
+// Hand a directory descriptor to the memo, held by the caller until
+// releaseMemoDir(). Returns 0 when no entry can be freed for it or another
+// lookup holds an older descriptor of that directory, the caller then keeps
+// ownership of fd.
+int addMemoDir(PathKey key, int fd) {
+    int stored = 0;
+    pthread_mutex_lock(&pathMemoLock);
+    int slot = findMemoSlot(key);
+    if (slot >= 0 && !pathMemo[slot].users) {
+        removeMemoSlot(slot);
+        slot = -1;
+    }
+    if (slot < 0 && (pathMemoCount < memoLimit() || evictMemoDir())) {
+        unsigned int empty = key.hash % PATH_MEMO_SIZE;
+        while (pathMemo[empty].key.hash) {
+            empty = (empty + 1) % PATH_MEMO_SIZE;
+        }
+        pathMemo[empty].key = key;
+        pathMemo[empty].fd = fd;
+        pathMemo[empty].users = 1;
+        pathMemo[empty].opened = monotonicMicros();
+        pathMemo[empty].lastUsed = ++pathMemoClock;
+        pathMemoCount++;
+        stored = 1;
+    }
+    pthread_mutex_unlock(&pathMemoLock);
+    return stored;
+}
+
+// Look up rest below the directory baseFd, whose path has the key base.
+// Directory prefixes are keyed by their full path text, so the
+// longest memoized prefix is reused and only the components after it are
+// opened (and memoized in turn). A missing top directory of a mount goes to
+// the negative cache, deeper ones may be created any time.
+// The caller holds the mount table read lock.
+int memoProbe(int baseFd, PathKey base, const char* rest, struct stat* st, int confine) {
+    PathKey keys[MAX_PATH_DEPTH];
+    const char* starts[MAX_PATH_DEPTH];
+    int lengths[MAX_PATH_DEPTH];
+    int depth = 0;
+
+    // Key every directory prefix of rest, "/Users", "/Users/bob"...
+    PathKey key = base;
+    const char* leaf = rest;
+    for (const char* slash = strchr(rest, '/'); slash; slash = strchr(leaf, '/')) {
+        if (slash > leaf) {
+            if (depth == MAX_PATH_DEPTH) {
+                return resolverFs->probe(baseFd, rest, st, confine);
+            }
+            key = childPathKey(key, leaf, slash - leaf);
+            keys[depth] = key;
+            starts[depth] = leaf;
+            lengths[depth] = (int) (slash - leaf);
+            depth++;
+        }
+        leaf = slash + 1;
+    }
+
+    // Fail at once under a directory known to be missing, otherwise start
+    // from the deepest directory already open
+    int dirFd = baseFd;
+    int next = 0;
+    for (int d = depth - 1; d >= 0; d--) {
+        if (isKnownMissingKey(keys[d])) {
+            return 0;
+        }
+        int fd = findMemoDir(keys[d]);
+        if (fd >= 0) {
+            dirFd = fd;
+            next = d + 1;
+            break;
+        }
+    }
+
+    // Walk the remaining components one openat() at a time. The current
+    // directory is either held in the memo (held) or owned here (ownedFd).
+    int held = next - 1;
+    int ownedFd = -1;
+    for (int d = next; d < depth; d++) {
+        char name[NAME_MAX + 1];
+        snprintf(name, sizeof(name), "%.*s", lengths[d], starts[d]);
+
+        int fd = resolverFs->openDir(dirFd, name, confine);
+        int openError = errno;
+        if (ownedFd >= 0) {
+            resolverFs->closeDir(ownedFd);
+            ownedFd = -1;
+        }
+        if (held >= 0) {
+            releaseMemoDir(keys[held]);
+            held = -1;
+        }
+        if (fd < 0) {
+            if (confine && d == 0 && (openError == ENOENT || openError == ENOTDIR)) {
+                rememberMissingKey(keys[d]);
+            }
+            return 0;
+        }
+        if (addMemoDir(keys[d], fd)) {
+            held = d;
+        } else {
+            ownedFd = fd;
+        }
+        dirFd = fd;
+    }
+
+    int found = resolverFs->probe(dirFd, leaf, st, confine);
+    if (ownedFd >= 0) {
+        resolverFs->closeDir(ownedFd);
+    }
+    if (held >= 0) {
+        releaseMemoDir(keys[held]);
+    }
+    return found;
+}
+
+// Whether an absolute path exists, walked through the directory memo.
+// The caller holds the mount table read lock.
+int pathExistsLocked(const char* path, struct stat* st) {
+    if (path[0] != '/' || rootDirFd < 0) {
+        return st ? stat(path, st) == 0 : access(path, F_OK) == 0;
+    }
+    return memoProbe(rootDirFd, pathKey("", 0), path + 1, st, 0);
+}
+
+// Same, taking the mount table read lock itself. Without /proc/mounts it is a plain lookup.
+int pathExists(const char* path, struct stat* st) {
+    if (path[0] != '/' || !acquireMountTable()) {
+        return st ? stat(path, st) == 0 : access(path, F_OK) == 0;
+    }
+    int found = pathExistsLocked(path, st);
+    releaseMountTable();
+    return found;
+}
+
+// Location of the learned drive table, following the XDG cache convention
+int driveCacheFile(char* path, int size, int createDir) {
+    const char* cacheHome = getenv("XDG_CACHE_HOME");
+    const char* home = getenv("HOME");
+    char dir[MAX_PATH_LEN];
+
+    if (cacheHome && cacheHome[0]) {
+        snprintf(dir, sizeof(dir), "%s", cacheHome);
+    } else if (home && home[0]) {
+        snprintf(dir, sizeof(dir), "%s/.cache", home);
+    } else {
+        return 0;
+    }
+
+    if (createDir) {
+        mkdir(dir, 0755);
+    }
+    snprintf(path, size, "%s/open_lnk", dir);
+    if (createDir) {
+        mkdir(path, 0755);
+    }
+    strncat(path, "/drives", size - strlen(path) - 1);
+    return 1;
+}
+
+// Load the mappings learned by previous runs. They are dropped when the
+// mount table no longer matches the one they were learned against.
+void loadDriveCache(void) {
+    if (driveCacheLoaded) {
+        return;
+    }
+    driveCacheLoaded = 1;
+    driveCacheCount = 0;
+
+    char path[MAX_PATH_LEN];
+    if (!driveCacheFile(path, sizeof(path), 0)) {
+        return;
+    }
+    FILE* cache = fopen(path, "r");
+    if (!cache) {
+        return;
+    }
+
+    char line[MAX_PATH_LEN + 128];
+    unsigned long long savedHash = 0;
+    if (!fgets(line, sizeof(line), cache) || sscanf(line, "mounts %llx", &savedHash) != 1 || savedHash != mountTableHash) {
+        // Mounts changed since the table was written, start over
+        driveCacheDirty = 1;
+        fclose(cache);
+        return;
+    }
+
+    // One mapping per line: letter, serial, label and mountpoint separated by tabs
+    while (fgets(line, sizeof(line), cache) && driveCacheCount < MAX_DRIVE_CACHE) {
+        line[strcspn(line, "\n")] = '\0';
+        char* serial = strchr(line, '\t');
+        char* label = serial ? strchr(serial + 1, '\t') : NULL;
+        char* mountpoint = label ? strchr(label + 1, '\t') : NULL;
+        if (!mountpoint || serial != line + 1) {
+            continue;
+        }
+        *label++ = '\0';
+        *mountpoint++ = '\0';
+
+        DriveMapping* mapping = &driveCache[driveCacheCount++];
+        mapping->letter = line[0];
+        mapping->serial = (unsigned int) strtoul(serial + 1, NULL, 16);
+        snprintf(mapping->label, sizeof(mapping->label), "%s", label);
+        snprintf(mapping->mountpoint, sizeof(mapping->mountpoint), "%s", mountpoint);
+    }
+    fclose(cache);
+}
+
+// Write the learned table back, through a temporary file so readers never see half of it
+void saveDriveCache(void) {
+    if (!driveCacheDirty) {
+        return;
+    }
+
+    char path[MAX_PATH_LEN], tmpPath[MAX_PATH_LEN + 8];
+    if (!driveCacheFile(path, sizeof(path), 1)) {
+        return;
+    }
+    // A temporary file of its own, several processes may save at once
+    snprintf(tmpPath, sizeof(tmpPath), "%s.XXXXXX", path);
+    int fd = mkstemp(tmpPath);
+    if (fd < 0) {
+        return;
+    }
+    FILE* cache = fdopen(fd, "w");
+    if (!cache) {
+        close(fd);
+        unlink(tmpPath);
+        return;
+    }
+    fprintf(cache, "mounts %llx\n", mountTableHash);
+    for (int i = 0; i < driveCacheCount; i++) {
+        DriveMapping* mapping = &driveCache[i];
+        fprintf(cache, "%c\t%08X\t%s\t%s\n", mapping->letter, mapping->serial, mapping->label, mapping->mountpoint);
+    }
+    if (fclose(cache) != 0 || rename(tmpPath, path) != 0) {
+        unlink(tmpPath);
+    }
+    driveCacheDirty = 0;
+}
+
+// Look up a learned mapping keyed by drive letter, volume serial and label
+DriveMapping* findDriveMapping(char letter, const LnkInfo* info) {
+    for (int i = 0; i < driveCacheCount; i++) {
+        DriveMapping* mapping = &driveCache[i];
+        if (mapping->letter == letter && mapping->serial == info->driveSerial && strcmp(mapping->label, info->volumeLabel) == 0) {
+            return mapping;
+        }
+    }
+    return NULL;
+}
+
+// Remember which mountpoint a drive resolved to, evicting the oldest entry when full
+void rememberDriveMapping(char letter, const LnkInfo* info, const char* mountpoint) {
+    DriveMapping* mapping = findDriveMapping(letter, info);
+    if (mapping && strcmp(mapping->mountpoint, mountpoint) == 0) {
+        return;
+    }
+
+    if (!mapping) {
+        if (driveCacheCount == MAX_DRIVE_CACHE) {
+            memmove(driveCache, driveCache + 1, sizeof(DriveMapping) * (MAX_DRIVE_CACHE - 1));
+            driveCacheCount--;
+        }
+        mapping = &driveCache[driveCacheCount++];
+        mapping->letter = letter;
+        mapping->serial = info->driveSerial;
+        snprintf(mapping->label, sizeof(mapping->label), "%s", info->volumeLabel);
+    }
+    snprintf(mapping->mountpoint, sizeof(mapping->mountpoint), "%s", mountpoint);
+    driveCacheDirty = 1;
+}
+
+// Resolve the shortcut's RelativePath against the directory holding the .lnk.
+// A copied tree keeps these valid, and checking one costs a single walk.
+char* findRelativePath(const char* lnkPath, const char* relativePath) {
+    // A shortcut handed over in memory has no folder to be relative to
+    if (!lnkPath[0]) {
+        return NULL;
+    }
+    char dirPath[MAX_PATH_LEN];
+    const char* lastSlash = strrchr(lnkPath, '/');
+    if (lastSlash) {
+        snprintf(dirPath, sizeof(dirPath), "%.*s", (int) (lastSlash - lnkPath + (lastSlash == lnkPath)), lnkPath);
+    } else {
+        strcpy(dirPath, ".");
+    }
+
+    char relPath[MAX_PATH_LEN];
+    snprintf(relPath, sizeof(relPath), "%s", relativePath);
+    for (int i = 0; relPath[i]; i++) {
+        if (relPath[i] == '\\') {
+            relPath[i] = '/';
+        }
+    }
+
+    // Canonical, so "tree/c/../../docs/x.txt" comes out as the same path
+    // whichever shortcut points at it. It does not exist when realpath() fails.
+    char joined[MAX_PATH_LEN * 2];
+    snprintf(joined, sizeof(joined), "%s/%s", dirPath, relPath);
+    char* fullPath = realpath(joined, NULL);
+    if (!fullPath) {
+        return NULL;
+    }
+    LOG(LOG_INFO, "Found relative path: %s\n", fullPath);
+    return fullPath;
+}
+
+// Join a Windows path onto its explicitly mapped drive (config, Wine, /mnt/<letter>).
+// One string join and one lookup, no mount table at all.
+char* findMappedPath(const char* windowsPath) {
+    char letter = (char) toupper((unsigned char) windowsPath[0]);
+    if (letter < 'A' || letter > 'Z' || windowsPath[1] != ':' || !driveMap[letter - 'A'][0]) {
+        return NULL;
+    }
+
+    char potentialPath[MAX_PATH_LEN * 2];
+    snprintf(potentialPath, sizeof(potentialPath), "%s%s", driveMap[letter - 'A'], windowsPath + 2);
+    LOG(LOG_INFO, "Trying mapped path: %s\n", potentialPath);
+    if (pathExists(potentialPath, NULL)) {
+        LOG(LOG_INFO, "Found valid path: %s\n", potentialPath);
+        return strdup(potentialPath);
+    }
+    return NULL;
+}
+
+// Filesystems that never hold user files, they are not worth a probe
+int isPseudoFilesystem(const char* fsType) {
+    static const char* pseudo[] = {
+        "proc", "sysfs", "devtmpfs", "devpts", "cgroup", "cgroup2", "securityfs", "debugfs", "tracefs",
+        "pstore", "bpf", "mqueue", "hugetlbfs", "configfs", "fusectl", "autofs", "binfmt_misc",
+        "efivarfs", "rpc_pipefs", "nsfs", "selinuxfs", "ramfs"
+    };
+    for (size_t i = 0; i < sizeof(pseudo) / sizeof(pseudo[0]); i++) {
+        if (strcmp(fsType, pseudo[i]) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int isNetworkFilesystem(const char* fsType) {
+    return strcmp(fsType, "cifs") == 0 || strcmp(fsType, "smb3") == 0 || strncmp(fsType, "nfs", 3) == 0
+        || strcmp(fsType, "fuse.sshfs") == 0 || strcmp(fsType, "9p") == 0;
+}
+
+// Whether a canonical path lies on a pseudo filesystem, going by the deepest
+// mount holding it. A relative target climbing into /proc is no user file.
+int isOnPseudoMount(const char* path) {
+    if (!acquireMountTable()) {
+        return 0;
+    }
+    int deepest = -1;
+    size_t deepestLength = 0;
+    for (int i = 0; i < mountCount; i++) {
+        const char* mountpoint = mountTable[i].mountpoint;
+        size_t length = strlen(mountpoint);
+        if (strcmp(mountpoint, "/") == 0) {
+            length = 0;
+        } else if (strncmp(path, mountpoint, length) != 0 || (path[length] && path[length] != '/')) {
+            continue;
+        }
+        if (deepest < 0 || length >= deepestLength) {
+            deepest = i;
+            deepestLength = length;
+        }
+    }
+    int pseudo = deepest >= 0 && isPseudoFilesystem(mountTable[deepest].fsType);
+    releaseMountTable();
+    return pseudo;
+}
+
+// Filesystems Windows itself writes
+int isWindowsFilesystem(const char* fsType) {
+    return strcmp(fsType, "ntfs") == 0 || strcmp(fsType, "ntfs3") == 0 || strcmp(fsType, "fuseblk") == 0
+        || strcmp(fsType, "vfat") == 0 || strcmp(fsType, "exfat") == 0 || strcmp(fsType, "msdos") == 0;
+}
+
+// How likely a mount is to hold the shortcut's volume, from cheap signals only:
+// the VolumeID DriveType and label against the mountpoint, device and filesystem type
+int scoreMount(const MountEntry* mount, const LnkInfo* info) {
+    const char* fsType = mount->fsType;
+    const char* mountpoint = mount->mountpoint;
+    int isBlockDevice = strncmp(mount->device, "/dev/", 5) == 0;
+    int underMedia = strncmp(mountpoint, "/media/", 7) == 0 || strncmp(mountpoint, "/run/media/", 11) == 0;
+    int score = 0;
+
+    if (isWindowsFilesystem(fsType)) {
+        score += 20;
+    }
+
+    switch (info->driveType) {
+    case 2:     // DRIVE_REMOVABLE
+        score += underMedia ? 30 : 0;
+        break;
+    case 3:     // DRIVE_FIXED
+        score += isBlockDevice ? 20 : 0;
+        break;
+    case 4:     // DRIVE_REMOTE
+        score += isNetworkFilesystem(fsType) ? 40 : 0;
+        break;
+    case 5:     // DRIVE_CDROM
+        score += strcmp(fsType, "iso9660") == 0 || strcmp(fsType, "udf") == 0 ? 40 : 0;
+        break;
+    }
+
+    // Desktops mount removable volumes under their label, /media/user/DATA
+    const char* base = strrchr(mountpoint, '/');
+    if (info->volumeLabel[0] && base && strcasecmp(base + 1, info->volumeLabel) == 0) {
+        score += 50;
+    }
+
+    // tmpfs, overlays and the root rarely hold a Windows volume
+    if (strcmp(fsType, "tmpfs") == 0 || strcmp(fsType, "overlay") == 0 || strcmp(fsType, "squashfs") == 0) {
+        score -= 20;
+    }
+    return score;
+}
+
+// Sort keys pack the inverted score above the table index, so ascending
+// order is best score first and otherwise /proc/mounts order
+int compareRankKeys(const void* a, const void* b) {
+    unsigned long long left = *(const unsigned long long*) a;
+    unsigned long long right = *(const unsigned long long*) b;
+    return (left > right) - (left < right);
+}
+
+// Order the mount table by score, best first and otherwise in /proc/mounts order.
+// Pseudo filesystems are left out. order holds mountCount entries. Returns the
+// number of candidates.
+int rankMounts(const LnkInfo* info, int* order) {
+    unsigned long long* keys = malloc((mountCount ? mountCount : 1) * sizeof(unsigned long long));
+    if (!keys) {
+        return 0;
+    }
+
+    int count = 0;
+    for (int i = 0; i < mountCount; i++) {
+        if (isPseudoFilesystem(mountTable[i].fsType)) {
+            continue;
+        }
+        unsigned int rank = 0x80000000u - (unsigned int) scoreMount(&mountTable[i], info);
+        keys[count++] = (unsigned long long) rank << 32 | (unsigned int) i;
+    }
+
+    qsort(keys, count, sizeof(unsigned long long), compareRankKeys);
+    for (int i = 0; i < count; i++) {
+        order[i] = (int) (keys[i] & 0xFFFFFFFFu);
+    }
+    free(keys);
+    return count;
+}
+
+// Check a hit against the size and write time the header recorded for the target.
+// Returns 1 when a recorded value matches or nothing was recorded.
+int matchesTargetMetadata(const struct stat* st, const LnkInfo* info) {
+    if (S_ISDIR(st->st_mode) || (!info->fileSize && !info->writeTime)) {
+        return 1;
+    }
+    if (info->fileSize && (unsigned int) st->st_size == info->fileSize) {
+        return 1;
+    }
+
+    // FILETIME counts 100ns steps since 1601, FAT keeps 2 second granularity
+    if (info->writeTime) {
+        long long writeTime = (long long) (info->writeTime / 10000000ULL) - 11644473600LL;
+        long long delta = (long long) st->st_mtime - writeTime;
+        if (delta >= -2 && delta <= 2) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Whether name is known not to exist below dirFd, a mount root or AT_FDCWD.
+// Errors other than ENOENT and ENOTDIR (a dead mount, no permission) leave the
+// question open.
+int isAbsent(int dirFd, const char* name) {
+    return !resolverFs->probe(dirFd, name, NULL, dirFd != AT_FDCWD) && (errno == ENOENT || errno == ENOTDIR);
+}
+
+// Same for the top directory of a path below a mount, answered from the memo
+// and the negative cache when they know it
+int isTopAbsent(int rootFd, PathKey mountKey, const char* topName) {
+    if (!topName[0]) {
+        return 0;
+    }
+    PathKey key = childPathKey(mountKey, topName, strlen(topName));
+    if (isKnownMissingKey(key)) {
+        return 1;
+    }
+    if (findMemoDir(key) >= 0) {
+        releaseMemoDir(key);
+        return 0;
+    }
+    if (!isAbsent(rootFd, topName)) {
+        return 0;
+    }
+    rememberMissingKey(key);
+    return 1;
+}
+
+// Probe every mount for the path. cancel, when set, stops the probe loop early.
+char* findMountedPath(const char* foundPath, const LnkInfo* info, atomic_int* cancel) {
+    char letter = (char) toupper((unsigned char) foundPath[0]);
+
+    // Extract the core part of the path without the drive letter (e.g., skip 'G:')
+    const char* corePath = foundPath + 2;
+    char potentialPath[MAX_PATH_LEN * 2];
+
+    char* mappedPath = findMappedPath(foundPath);
+    if (mappedPath) {
+        return mappedPath;
+    }
+
+    if (!acquireMountTable()) {
+        return NULL;
+    }
+
+    // The first component ("/Users") keys the volume in the negative cache: when
+    // no mount has it, later shortcuts below it fail at once. A drive root ("G:")
+    // is keyed as "/".
+    const char* topPath = corePath[0] ? corePath : "/";
+    int topLength = 1 + (int) strcspn(topPath + 1, "/");
+    char topName[NAME_MAX + 1];
+    snprintf(topName, sizeof(topName), "%.*s", topLength - 1, topPath + 1);
+    char volumeKey[MAX_PATH_LEN + 96];
+    snprintf(volumeKey, sizeof(volumeKey), "%c:%08X:%s:%.*s", letter, info->driveSerial, info->volumeLabel, topLength, topPath);
+    if (isKnownMissing(volumeKey)) {
+        TRACE(cache_hit, "negative", volumeKey);
+        atomic_fetch_add(&cacheHitsTotal[CACHE_NEGATIVE], 1);
+        LOG(LOG_DEBUG, "Volume known to be missing: %s\n", volumeKey);
+        releaseMountTable();
+        return NULL;
+    }
+    atomic_fetch_add(&cacheMissesTotal[CACHE_NEGATIVE], 1);
+
+    char learnedMount[MAX_PATH_LEN] = "";
+    pthread_mutex_lock(&driveCacheLock);
+    loadDriveCache();
+    DriveMapping* learned = findDriveMapping(letter, info);
+    if (learned) {
+        snprintf(learnedMount, sizeof(learnedMount), "%s", learned->mountpoint);
+    }
+    pthread_mutex_unlock(&driveCacheLock);
+
+    // Try the mountpoint this drive resolved to last time before probing every mount
+    if (learnedMount[0]) {
+        snprintf(potentialPath, sizeof(potentialPath), "%s%s", learnedMount, corePath);
+        LOG(LOG_INFO, "Trying learned path: %s\n", potentialPath);
+        if (pathExistsLocked(potentialPath, NULL)) {
+            TRACE(cache_hit, "learned", potentialPath);
+            atomic_fetch_add(&cacheHitsTotal[CACHE_LEARNED], 1);
+            LOG(LOG_INFO, "Found valid path: %s\n", potentialPath);
+            releaseMountTable();
+            return strdup(potentialPath);
+        }
+    }
+    TRACE(cache_miss, "learned", foundPath);
+    atomic_fetch_add(&cacheMissesTotal[CACHE_LEARNED], 1);
+
+    // The volume key is only cached when its top directory is absent from every
+    // mount tried, a missing file below it says nothing about its neighbours
+    int topMissing = 1;
+    if (learnedMount[0]) {
+        snprintf(potentialPath, sizeof(potentialPath), "%s/%s", learnedMount, topName);
+        topMissing = isAbsent(AT_FDCWD, potentialPath);
+    }
+
+    // Probe the likeliest mounts first
+    int* order = malloc((mountCount ? mountCount : 1) * sizeof(int));
+    if (!order) {
+        releaseMountTable();
+        return NULL;
+    }
+    int candidates = rankMounts(info, order);
+
+    // Probes are relative to each mount's root descriptor and go through the
+    // directory memo, nothing is formatted until a hit. The size and write time
+    // are only fetched when the header has them.
+    const char* relPath = corePath[0] == '/' ? corePath + 1 : corePath;
+    int needMetadata = info->fileSize || info->writeTime;
+
+    // A hit whose size and write time both disagree with the header is only kept
+    // as a fallback, a later mount may hold the real target
+    int foundIndex = -1;
+    int fallbackIndex = -1;
+    int probes = 0;
+    for (int i = 0; i < candidates && foundIndex < 0; i++) {
+        if (cancel && atomic_load(cancel)) {
+            break;
+        }
+
+        MountEntry* mount = &mountTable[order[i]];
+        if (learnedMount[0] && strcmp(mount->mountpoint, learnedMount) == 0) {
+            continue;
+        }
+
+        int rootFd = mountRootFd(mount);
+        if (rootFd < 0) {
+            continue;
+        }
+
+        LOG(LOG_DEBUG, "Trying potential path: %s%s\n", mount->mountpoint, corePath);
+
+        // Check if the potential path exists below this mount
+        struct stat st;
+        PathKey mountKey = pathKey(mount->mountpoint, strlen(mount->mountpoint));
+        long long probeStart = metricsEnabled ? monotonicMicros() : 0;
+        int exists = memoProbe(rootFd, mountKey, relPath, needMetadata ? &st : NULL, 1);
+        TRACE(mount_probe, mount->mountpoint, relPath, exists);
+        probes++;
+        if (topMissing && (exists || !isTopAbsent(rootFd, mountKey, topName))) {
+            topMissing = 0;
+        }
+        if (metricsEnabled && monotonicMicros() - probeStart > SLOW_PROBE_US) {
+            countSlowProbe(mount->mountpoint);
+        }
+        if (!exists) {
+            continue;
+        }
+        if (needMetadata && !matchesTargetMetadata(&st, info)) {
+            if (fallbackIndex < 0) {
+                fallbackIndex = order[i];
+            }
+            continue;
+        }
+        foundIndex = order[i];
+    }
+
+    atomic_fetch_add(&probesTotal, probes);
+    observe(&probesPerRequest, probes);
+
+    int cancelled = cancel && atomic_load(cancel);
+    if (foundIndex < 0 && !cancelled) {
+        foundIndex = fallbackIndex;
+    }
+
+    char* found = NULL;
+    if (foundIndex >= 0) {
+        const char* mountpoint = mountTable[foundIndex].mountpoint;
+        snprintf(potentialPath, sizeof(potentialPath), "%s%s", mountpoint, corePath);
+        LOG(LOG_INFO, "Found valid path: %s\n", potentialPath);
+        found = strdup(potentialPath);
+        pthread_mutex_lock(&driveCacheLock);
+        rememberDriveMapping(letter, info, mountpoint);
+        pthread_mutex_unlock(&driveCacheLock);
+    } else if (!cancelled && topMissing) {
+        // No mount has the top directory, later shortcuts below it fail at once
+        rememberMissing(volumeKey);
+    }
+    free(order);
+    releaseMountTable();
+
+    // Also rewrites a stale table against the current mounts
+    pthread_mutex_lock(&driveCacheLock);
+    saveDriveCache();
+    pthread_mutex_unlock(&driveCacheLock);
+    return found;
+}
+
+// A network link whose share is mounted here over CIFS/SMB: same "//server/share" device
+char* findShareMount(const LnkInfo* info) {
+    char share[256];
+    snprintf(share, sizeof(share), "%s", info->netName);
+    for (int i = 0; share[i]; i++) {
+        if (share[i] == '\\') {
+            share[i] = '/';
+        }
+    }
+
+    if (!acquireMountTable()) {
+        return NULL;
+    }
+    char* found = NULL;
+    for (int i = 0; i < mountCount && !found; i++) {
+        if (strcasecmp(mountTable[i].device, share) != 0) {
+            continue;
+        }
+
+        char potentialPath[MAX_PATH_LEN * 2];
+        snprintf(potentialPath, sizeof(potentialPath), "%s/%s", mountTable[i].mountpoint, info->commonPathSuffix);
+        for (int j = 0; potentialPath[j]; j++) {
+            if (potentialPath[j] == '\\') {
+                potentialPath[j] = '/';
+            }
+        }
+        LOG(LOG_INFO, "Trying share path: %s\n", potentialPath);
+        if (pathExistsLocked(potentialPath, NULL)) {
+            found = strdup(potentialPath);
+        }
+    }
+    releaseMountTable();
+    return found;
+}
+
+// Expand %VARIABLE% references of the environment block with our own environment.
+// %USERPROFILE% falls back to $HOME. Returns NULL when a variable is not set.
+char* findEnvironmentPath(const char* environmentPath) {
+    char path[MAX_PATH_LEN];
+    int length = 0;
+
+    for (const char* p = environmentPath; *p && length < MAX_PATH_LEN - 1; p++) {
+        const char* close = *p == '%' ? strchr(p + 1, '%') : NULL;
+        if (!close) {
+            path[length++] = *p == '\\' ? '/' : *p;
+            continue;
+        }
+
+        char name[128];
+        snprintf(name, sizeof(name), "%.*s", (int) (close - p - 1), p + 1);
+        const char* value = getenv(name);
+        if (!value && strcasecmp(name, "USERPROFILE") == 0) {
+            value = getenv("HOME");
+        }
+        if (!value) {
+            return NULL;
+        }
+        length += snprintf(path + length, MAX_PATH_LEN - length, "%s", value);
+        if (length >= MAX_PATH_LEN) {
+            return NULL;
+        }
+        p = close;
+    }
+    path[length] = '\0';
+
+    LOG(LOG_INFO, "Trying environment path: %s\n", path);
+    return pathExists(path, NULL) ? strdup(path) : NULL;
+}
+
+// Known folders we can map onto the XDG user directories
+typedef struct {
+    unsigned int data1;
+    unsigned short data2, data3;
+    unsigned char data4[8];
+    const char* xdgKey;         // Key in user-dirs.dirs, NULL for the profile itself
+    const char* fallback;       // Directory under $HOME when user-dirs.dirs has no entry
+} KnownFolder;
+
+const KnownFolder knownFolders[] = {
+    {0x5E6C858F, 0x0E22, 0x4760, {0x9A, 0xFE, 0xEA, 0x33, 0x17, 0xB6, 0x71, 0x73}, NULL, ""},
+    {0xB4BFCC3A, 0xDB2C, 0x424C, {0xB0, 0x29, 0x7F, 0xE9, 0x9A, 0x87, 0xC6, 0x41}, "XDG_DESKTOP_DIR", "Desktop"},
+    {0xFDD39AD0, 0x238F, 0x46AF, {0xAD, 0xB4, 0x6C, 0x85, 0x48, 0x03, 0x69, 0xC7}, "XDG_DOCUMENTS_DIR", "Documents"},
+    {0x374DE290, 0x123F, 0x4565, {0x91, 0x64, 0x39, 0xC4, 0x92, 0x5E, 0x46, 0x7B}, "XDG_DOWNLOAD_DIR", "Downloads"},
+    {0x4BD8D571, 0x6D19, 0x48D3, {0xBE, 0x97, 0x42, 0x22, 0x20, 0x08, 0x0E, 0x43}, "XDG_MUSIC_DIR", "Music"},
+    {0x33E28130, 0x4E1E, 0x4676, {0x83, 0x5A, 0x98, 0x39, 0x5C, 0x3B, 0xC3, 0xBB}, "XDG_PICTURES_DIR", "Pictures"},
+    {0x18989B1D, 0x99B5, 0x455B, {0x84, 0x1C, 0xAB, 0x7C, 0x74, 0xE4, 0xDD, 0xFC}, "XDG_VIDEOS_DIR", "Videos"},
+};
+
+// Look a directory up in user-dirs.dirs (XDG_DOCUMENTS_DIR="$HOME/Documents")
+int xdgUserDir(const KnownFolder* folder, char* dir, int size) {
+    const char* home = getenv("HOME");
+    if (!home) {
+        return 0;
+    }
+    snprintf(dir, size, "%s%s%s", home, folder->fallback[0] ? "/" : "", folder->fallback);
+    if (!folder->xdgKey) {
+        return 1;
+    }
+
+    const char* configHome = getenv("XDG_CONFIG_HOME");
+    char path[MAX_PATH_LEN];
+    if (configHome && configHome[0]) {
+        snprintf(path, sizeof(path), "%s/user-dirs.dirs", configHome);
+    } else {
+        snprintf(path, sizeof(path), "%s/.config/user-dirs.dirs", home);
+    }
+    FILE* dirs = fopen(path, "r");
+    if (!dirs) {
+        return 1;
+    }
+
+    char line[MAX_PATH_LEN];
+    size_t keyLength = strlen(folder->xdgKey);
+    while (fgets(line, sizeof(line), dirs)) {
+        if (strncmp(line, folder->xdgKey, keyLength) != 0 || strncmp(line + keyLength, "=\"", 2) != 0) {
+            continue;
+        }
+        char* value = line + keyLength + 2;
+        value[strcspn(value, "\"")] = '\0';
+        if (strncmp(value, "$HOME", 5) == 0) {
+            snprintf(dir, size, "%s%s", home, value + 5);
+        } else {
+            snprintf(dir, size, "%s", value);
+        }
+        break;
+    }
+    fclose(dirs);
+    return 1;
+}
+
+// KnownFolderDataBlock: the matching XDG directory plus the IDList items below it
+char* findKnownFolderPath(const LnkInfo* info) {
+    const unsigned char* id = info->knownFolderId;
+    for (size_t i = 0; i < sizeof(knownFolders) / sizeof(knownFolders[0]); i++) {
+        const KnownFolder* folder = &knownFolders[i];
+        if (readU32(id) != folder->data1 || readU16(id + 4) != folder->data2 || readU16(id + 6) != folder->data3 || memcmp(id + 8, folder->data4, 8) != 0) {
+            continue;
+        }
+
+        char dir[MAX_PATH_LEN], path[MAX_PATH_LEN * 2];
+        if (!xdgUserDir(folder, dir, sizeof(dir))) {
+            return NULL;
+        }
+        snprintf(path, sizeof(path), "%s/%s", dir, info->knownFolderSubPath);
+        for (int j = 0; path[j]; j++) {
+            if (path[j] == '\\') {
+                path[j] = '/';
+            }
+        }
+        LOG(LOG_INFO, "Trying known folder path: %s\n", path);
+        return pathExists(path, NULL) ? strdup(path) : NULL;
+    }
+    return NULL;
+}
+
+// The path rebuilt from the IDList, as is and through the explicit drive table
+char* findIdListPath(const char* idListPath) {
+    char path[MAX_PATH_LEN];
+    snprintf(path, sizeof(path), "%s", idListPath);
+    for (int i = 0; path[i]; i++) {
+        if (path[i] == '\\') {
+            path[i] = '/';
+        }
+    }
+
+    if (pathExists(path, NULL)) {
+        return strdup(path);
+    }
+    return findMappedPath(path);
+}
+
+
+/*
+____ ____ ____ ____ 
+|__/ |__| |    |___ 
+|  \ |  | |___ |___ 
+
+*/
+
+// Resolution strategies in priority order: a hit from an earlier one always wins
+enum {
+    STRATEGY_LINK_INFO,
+    STRATEGY_RELATIVE,
+    STRATEGY_ENVIRONMENT,
+    STRATEGY_KNOWN_FOLDER,
+    STRATEGY_ID_LIST,
+    STRATEGY_MOUNTS,
+    STRATEGY_COUNT
+};
+
+typedef struct ResolveRace ResolveRace;
+
+typedef struct {
+    ResolveRace* race;
+    int strategy;
+} StrategySlot;
+
+// Shared between the caller and the strategy threads. Threads may outlive the
+// caller (a probe stuck on a dead mount), so the last one out frees it.
+struct ResolveRace {
+    char lnkPath[MAX_PATH_LEN];
+    char windowsPath[MAX_PATH_LEN];     // Absolute target with '/' separators, may be empty
+    LnkInfo info;
+    atomic_int cancelled;               // Cancellation token, set once a winner is picked
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    int finished[STRATEGY_COUNT];
+    char* results[STRATEGY_COUNT];
+    StrategySlot slots[STRATEGY_COUNT];
+    int refs;
+};
+
+void releaseRace(ResolveRace* race) {
+    pthread_mutex_lock(&race->lock);
+    int last = --race->refs == 0;
+    pthread_mutex_unlock(&race->lock);
+    if (!last) {
+        return;
+    }
+
+    for (int i = 0; i < STRATEGY_COUNT; i++) {
+        free(race->results[i]);
+    }
+    pthread_mutex_destroy(&race->lock);
+    pthread_cond_destroy(&race->changed);
+    free(race);
+}
+
+char* runStrategy(ResolveRace* race, int strategy) {
+    const LnkInfo* info = &race->info;
+    char* found = NULL;
+
+    // Mount probing falls back on the IDList path when LinkInfo had no drive path
+    char mountPath[MAX_PATH_LEN];
+    snprintf(mountPath, sizeof(mountPath), "%s", race->windowsPath[1] == ':' ? race->windowsPath : info->idListPath);
+    for (int i = 0; mountPath[i]; i++) {
+        if (mountPath[i] == '\\') {
+            mountPath[i] = '/';
+        }
+    }
+
+    switch (strategy) {
+    case STRATEGY_LINK_INFO:
+        if (race->windowsPath[0] && pathExists(race->windowsPath, NULL)) {
+            found = strdup(race->windowsPath);
+        } else if (info->netName[0]) {
+            found = findShareMount(info);
+        }
+        break;
+    case STRATEGY_RELATIVE:
+        found = findRelativePath(race->lnkPath, info->relativePath);
+        if (found && isOnPseudoMount(found)) {
+            LOG(LOG_INFO, "Ignoring relative path on a pseudo filesystem: %s\n", found);
+            free(found);
+            found = NULL;
+        }
+        break;
+    case STRATEGY_ENVIRONMENT:
+        found = findEnvironmentPath(info->environmentPath);
+        break;
+    case STRATEGY_KNOWN_FOLDER:
+        found = findKnownFolderPath(info);
+        break;
+    case STRATEGY_ID_LIST:
+        found = findIdListPath(info->idListPath);
+        break;
+    case STRATEGY_MOUNTS:
+        found = findMountedPath(mountPath, info, &race->cancelled);
+        break;
+    }
+    return found;
+}
+
+void* strategyThread(void* arg) {
+    StrategySlot* slot = arg;
+    ResolveRace* race = slot->race;
+    char* found = atomic_load(&race->cancelled) ? NULL : runStrategy(race, slot->strategy);
+
+    pthread_mutex_lock(&race->lock);
+    race->results[slot->strategy] = found;
+    race->finished[slot->strategy] = 1;
+    pthread_cond_broadcast(&race->changed);
+    pthread_mutex_unlock(&race->lock);
+
+    releaseRace(race);
+    return NULL;
+}
+
+// Whether a strategy has anything to work with for this shortcut
+int strategyApplies(const ResolveRace* race, int strategy) {
+    const LnkInfo* info = &race->info;
+    switch (strategy) {
+    case STRATEGY_LINK_INFO:
+        return race->windowsPath[0] || info->netName[0];
+    case STRATEGY_RELATIVE:
+        return info->relativePath[0] != '\0';
+    case STRATEGY_ENVIRONMENT:
+        return info->environmentPath[0] != '\0';
+    case STRATEGY_KNOWN_FOLDER:
+        return info->hasKnownFolder;
+    case STRATEGY_ID_LIST:
+        return info->idListPath[0] && strcasecmp(info->idListPath, info->localBasePath) != 0;
+    case STRATEGY_MOUNTS:
+        return (race->windowsPath[0] && race->windowsPath[1] == ':') || info->idListPath[0];
+    }
+    return 0;
+}
+
+// Only share and mount probing can block on the network or a dead mount, the
+// other strategies are lookups on local paths
+int strategyIsSlow(const ResolveRace* race, int strategy) {
+    return strategy == STRATEGY_MOUNTS || (strategy == STRATEGY_LINK_INFO && race->info.netName[0]);
+}
+
+// Run a strategy on a thread of its own, or on the caller's
+void startStrategy(ResolveRace* race, int strategy, int threaded) {
+    StrategySlot* slot = &race->slots[strategy];
+    slot->race = race;
+    slot->strategy = strategy;
+    pthread_mutex_lock(&race->lock);
+    race->refs++;
+    pthread_mutex_unlock(&race->lock);
+
+    pthread_t thread;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (!threaded || pthread_create(&thread, &attr, strategyThread, slot) != 0) {
+        // No thread needed or none to spare, run it here instead
+        strategyThread(slot);
+    }
+    pthread_attr_destroy(&attr);
+}
+
+// Run every applicable strategy and return the highest priority hit. The local
+// lookups run here in priority order while a network share is probed on a
+// thread. Mounts are only probed when they all missed, on a thread when the
+// share probe is still going so the first to answer can win. A shortcut that
+// resolves locally starts no thread at all, and a hit cancels the slower probes.
+char* resolveTarget(const char* lnkPath, const char* windowsPath, const LnkInfo* info) {
+    ResolveRace* race = calloc(1, sizeof(ResolveRace));
+    if (!race) {
+        return NULL;
+    }
+    snprintf(race->lnkPath, sizeof(race->lnkPath), "%s", lnkPath);
+    snprintf(race->windowsPath, sizeof(race->windowsPath), "%s", windowsPath);
+    race->info = *info;
+    atomic_init(&race->cancelled, 0);
+    pthread_mutex_init(&race->lock, NULL);
+    pthread_cond_init(&race->changed, NULL);
+    race->refs = 1;
+
+    for (int i = 0; i < STRATEGY_COUNT; i++) {
+        if (!strategyApplies(race, i)) {
+            race->finished[i] = 1;
+        }
+    }
+    if (!race->finished[STRATEGY_LINK_INFO] && strategyIsSlow(race, STRATEGY_LINK_INFO)) {
+        startStrategy(race, STRATEGY_LINK_INFO, 1);
+    }
+
+    // Strategies ranked below a local hit cannot win, they are skipped
+    int localHit = 0;
+    for (int i = 0; i < STRATEGY_COUNT; i++) {
+        if (strategyIsSlow(race, i) || race->finished[i]) {
+            continue;
+        }
+        if (localHit) {
+            race->finished[i] = 1;
+            continue;
+        }
+        startStrategy(race, i, 0);
+        localHit = race->results[i] != NULL;
+    }
+
+    if (!race->finished[STRATEGY_MOUNTS]) {
+        if (localHit) {
+            race->finished[STRATEGY_MOUNTS] = 1;
+        } else {
+            pthread_mutex_lock(&race->lock);
+            int sharePending = !race->finished[STRATEGY_LINK_INFO];
+            pthread_mutex_unlock(&race->lock);
+            startStrategy(race, STRATEGY_MOUNTS, sharePending);
+        }
+    }
+
+    // Walk the strategies in priority order: wait on the first unfinished one,
+    // stop at the first finished one that found something
+    char* winner = NULL;
+    pthread_mutex_lock(&race->lock);
+    for (;;) {
+        int pending = 0;
+        for (int i = 0; i < STRATEGY_COUNT; i++) {
+            if (!race->finished[i]) {
+                pending = 1;
+                break;
+            }
+            if (race->results[i]) {
+                winner = race->results[i];
+                race->results[i] = NULL;
+                break;
+            }
+        }
+        if (winner || !pending) {
+            break;
+        }
+        pthread_cond_wait(&race->changed, &race->lock);
+    }
+    atomic_store(&race->cancelled, 1);
+    pthread_mutex_unlock(&race->lock);
+
+    releaseRace(race);
+    return winner;
+}
+
+
+/*
+___  ____ ____ ____ ____ ____ ____ 
+|__] |__/ |  | |    |___ [__  [__  
+|    |  \ |__| |___ |___ ___] ___] 
+
+*/
+
+void toForwardSlashes(char* path) {
+    for (int i = 0; path[i]; i++) {
+        if (path[i] == '\\') {
+            path[i] = '/';
+        }
+    }
+}
+
+// Count one finished request and how long it took
+int countRequest(int result, long long start) {
+    atomic_fetch_add(&requestsTotal[result], 1);
+    observe(&requestLatency, monotonicMicros() - start);
+    return result;
+}
+
+// Find the target of a shortcut already read into memory. lnkPath names it and
+// anchors its relative path; start is when the request began. *targetPath
+// receives the resolved path, or the path extracted from the shortcut when
+// nothing was found; the caller frees it. info receives what was parsed out of
+// the shortcut.
+int resolveLnkData(const char* lnkPath, const unsigned char* data, int length, char** targetPath, LnkInfo* info, long long start) {
+    *targetPath = NULL;
+
+    // Pull the paths, volume and known folder details out of the shortcut structures
+    TRACE(parse_start, lnkPath, length);
+    if (!parseLnk(data, length, info)) {
+        atomic_fetch_add(&parseErrorsTotal, 1);
+    }
+    TRACE(parse_end, lnkPath, info->valid, info->linkFlags);
+    info->lnkSize = length;
+
+    // Prefer the target recorded in LinkInfo, fall back to scanning the raw bytes
+    char* foundPath = buildLinkInfoPath(info);
+    if (!foundPath) {
+        // Convert the binary data to ASCII representation
+        char* asciiData = binaryToASCII(data, length);
+
+        // Extract the longest valid file path from the ASCII data
+        foundPath = findLongestValidPath(asciiData);
+        free(asciiData);
+    }
+
+    // Convert any backslashes to forward slashes
+    if (foundPath) {
+        toForwardSlashes(foundPath);
+    }
+
+    // Race every resolution strategy and keep the best hit
+    char* actualPath = resolveTarget(lnkPath, foundPath ? foundPath : "", info);
+    if (actualPath) {
+        free(foundPath);
+        *targetPath = actualPath;
+        return countRequest(RESULT_FOUND, start);
+    }
+
+    // A shortcut holding nothing but an IDList still names its target
+    if (!foundPath && info->idListPath[0]) {
+        foundPath = strdup(info->idListPath);
+        toForwardSlashes(foundPath);
+    }
+
+    *targetPath = foundPath;
+    return countRequest(foundPath ? RESULT_MISSING : RESULT_NO_PATH, start);
+}
+
+// Read a shortcut and find its target, as resolveLnkData() does
+int resolveLnkFile(const char* lnkPath, char** targetPath, LnkInfo* info) {
+    *targetPath = NULL;
+    memset(info, 0, sizeof(*info));
+    long long start = monotonicMicros();
+
+    // Open the .lnk file for reading in binary mode
+    FILE* file = fopen(lnkPath, "rb");
+    TRACE(file_open, lnkPath, file != NULL);
+    if (!file) {
+        return countRequest(RESULT_UNREADABLE, start);
+    }
+
+    unsigned char data[MAX_DATA_SIZE];
+
+    // Read the contents of the .lnk file into the data buffer
+    int bytesRead = fread(data, 1, MAX_DATA_SIZE, file);
+    struct stat lnkStat;
+    long long lnkSize = fstat(fileno(file), &lnkStat) == 0 ? (long long) lnkStat.st_size : bytesRead;
+
+    // Close the file as it's no longer needed
+    fclose(file);
+
+    int result = resolveLnkData(lnkPath, data, bytesRead, targetPath, info, start);
+    info->lnkSize = lnkSize;
+    return result;
+}
+
+/*
+____ ___  _ 
+|__| |__] | 
+|  | |    | 
+
+*/
+
+// The library calls of lnkReader.h
+pthread_once_t lnkInitOnce = PTHREAD_ONCE_INIT;
+
+void loadLibraryState(void) {
+    initLog(LOG_OFF);
+    loadDriveMap();
+}
+
+void lnkInit(void) {
+    pthread_once(&lnkInitOnce, loadLibraryState);
+}
+
+int lnkResolveBuffer(const void* data, size_t length, const char* name, char** targetPath) {
+    lnkInit();
+    long long start = monotonicMicros();
+
+    // Only what a file read would see, so both give the same answer
+    LnkInfo info;
+    memset(&info, 0, sizeof(info));
+    int bytes = length < MAX_DATA_SIZE ? (int) length : MAX_DATA_SIZE;
+    return resolveLnkData(name ? name : "", data, bytes, targetPath, &info, start);
+}
+
+char* lnkRecordedTarget(const void* data, size_t length) {
+    LnkInfo info;
+    if (!parseLnk(data, length < INT_MAX ? (int) length : INT_MAX, &info)) {
+        return NULL;
+    }
+    return recordedTarget(&info);
+}
+
+const char* lnkResultName(int result) {
+    return result >= RESULT_FOUND && result <= RESULT_UNREADABLE ? resultNames[result] : "unknown";
+}
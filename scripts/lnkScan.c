@@ -0,0 +1,810 @@
+// --resolve, --scan, --stats and --merge: one JSON record per shortcut, for
+// whole trees, sharded over hosts and checkpointed
+
+#include "lnkInternal.h"
+
+
+/*
+____ ____ ____ _  _ 
+[__  |    |__| |\ | 
+___] |___ |  | | \| 
+
+*/
+
+// Write a string as a JSON string literal
+void writeJsonString(FILE* out, const char* str) {
+    fputc('"', out);
+    for (const unsigned char* p = (const unsigned char*) str; *p; p++) {
+        if (*p == '"' || *p == '\\') {
+            fprintf(out, "\\%c", *p);
+        } else if (*p < 0x20) {
+            fprintf(out, "\\u%04x", *p);
+        } else {
+            fputc(*p, out);
+        }
+    }
+    fputc('"', out);
+}
+
+// --shard i/N: this instance only takes the shortcuts whose path hashes to i.
+// The hash is FNV-1a of the path as given to --resolve, or relative to the
+// scanned root, so every host agrees wherever the share is mounted.
+int shardIndex = 0;
+int shardCount = 1;
+int shardDepth = 0;     // Scans: hash whole subtrees at this depth instead of files
+
+int inShard(const char* path) {
+    return shardCount <= 1 || hashBytes(FNV_OFFSET, path, strlen(path)) % shardCount == (unsigned int) shardIndex;
+}
+
+// The fields of a --resolve record, without its closing brace
+void writeResolvedRecord(const char* lnkPath, int result, const char* targetPath) {
+    fputs("{\"lnk\":", stdout);
+    writeJsonString(stdout, lnkPath);
+    printf(",\"status\":\"%s\"", resultNames[result]);
+    if (targetPath) {
+        fputs(",\"target\":", stdout);
+        writeJsonString(stdout, targetPath);
+    }
+}
+
+// Resolve one shortcut and print its JSON record
+void printResolved(const char* lnkPath, void* context) {
+    (void) context;
+#ifdef LNK_ALLOC_STATS
+    static int printed = 0;
+    AllocMark mark;
+    if (printed++ == allocWarmupFiles) {
+        // Keep the records so far should the next allocation abort
+        fflush(stdout);
+        atomic_store(&allocSteady, 1);
+    }
+    beginAllocFile(&mark);
+#endif
+    char* targetPath;
+    LnkInfo info;
+    int result = resolveLnkFile(lnkPath, &targetPath, &info);
+
+    writeResolvedRecord(lnkPath, result, targetPath);
+#ifdef LNK_ALLOC_STATS
+    endAllocFile(&mark, stdout);
+#endif
+    fputs("}\n", stdout);
+    free(targetPath);
+}
+
+// Bulk mode: resolve every shortcut and print one JSON object per line, opening nothing.
+// Missing volumes and prefixes found by one shortcut are skipped for all the others.
+int resolveBulk(int count, char* paths[]) {
+    for (int i = 0; i < count; i++) {
+        if (inShard(paths[i])) {
+            printResolved(paths[i], NULL);
+        }
+    }
+#ifdef LNK_ALLOC_STATS
+    atomic_store(&allocSteady, 0);
+#endif
+    return 0;
+}
+
+// Shortcuts under a tree are visited depth first with every directory listing
+// sorted. Directories sort as "name/", which makes the visiting order the byte
+// order of the full paths: outputs of a scan come out sorted.
+typedef struct {
+    char** keys;            // Entry names, directories with a trailing '/'
+    int count;
+    int next;
+    int pathLength;         // Length of the directory path in the walk buffer
+} ScanFrame;
+
+typedef void (*ScanVisitor)(const char* path, void* context);
+
+// Resuming a scan: every path up to this one, in walk order, is already done
+char resumeAfter[PATH_MAX] = "";
+
+// Whether a file, or a whole directory given as "dir/", was finished before the
+// checkpoint. The walk order is byte order, so a directory is done when it
+// sorts before the last finished path without being one of its parents.
+int scanDone(const char* path, int isDir) {
+    if (!resumeAfter[0]) {
+        return 0;
+    }
+    if (!isDir) {
+        return strcmp(path, resumeAfter) <= 0;
+    }
+    return strncmp(path, resumeAfter, strlen(path)) != 0 && strcmp(path, resumeAfter) < 0;
+}
+
+int compareScanKeys(const void* a, const void* b) {
+    return strcmp(*(char* const*) a, *(char* const*) b);
+}
+
+int hasLnkExtension(const char* name) {
+    size_t length = strlen(name);
+    return length >= 4 && strcasecmp(name + length - 4, ".lnk") == 0;
+}
+
+// List and sort one directory into frame. Symlinked directories are not followed.
+int readScanFrame(const char* path, ScanFrame* frame) {
+    DIR* dir = opendir(path);
+    if (!dir) {
+        return 0;
+    }
+
+    int capacity = 0;
+    frame->keys = NULL;
+    frame->count = 0;
+    frame->next = 0;
+    struct dirent* entry;
+    while ((entry = readdir(dir))) {
+        const char* name = entry->d_name;
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+            continue;
+        }
+
+        int isDir = entry->d_type == DT_DIR;
+        if (entry->d_type == DT_UNKNOWN) {
+            struct stat st;
+            isDir = fstatat(dirfd(dir), name, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode);
+        }
+        if (!isDir && !hasLnkExtension(name)) {
+            continue;
+        }
+
+        if (frame->count == capacity) {
+            capacity = capacity ? capacity * 2 : 32;
+            char** grown = realloc(frame->keys, capacity * sizeof(char*));
+            if (!grown) {
+                break;
+            }
+            frame->keys = grown;
+        }
+        size_t length = strlen(name);
+        char* key = malloc(length + 2);
+        if (!key) {
+            break;
+        }
+        memcpy(key, name, length);
+        key[length] = isDir ? '/' : '\0';
+        key[length + 1] = '\0';
+        frame->keys[frame->count++] = key;
+    }
+    closedir(dir);
+
+    qsort(frame->keys, frame->count, sizeof(char*), compareScanKeys);
+    return 1;
+}
+
+void freeScanFrame(ScanFrame* frame) {
+    for (int i = 0; i < frame->count; i++) {
+        free(frame->keys[i]);
+    }
+    free(frame->keys);
+}
+
+// Call visit for every .lnk below root, or for root itself when it is a file.
+// The frontier is an explicit stack of directory listings, one per level.
+void scanTree(const char* root, ScanVisitor visit, void* context) {
+    struct stat st;
+    if (stat(root, &st) != 0) {
+        LOG(LOG_WARN, "Cannot scan %s\n", root);
+        return;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        if (inShard(root) && !scanDone(root, 0)) {
+            visit(root, context);
+        }
+        return;
+    }
+
+    char path[PATH_MAX];
+    int rootLength = snprintf(path, sizeof(path), "%s", root);
+    while (rootLength > 1 && path[rootLength - 1] == '/') {
+        path[--rootLength] = '\0';
+    }
+    if (rootLength + 1 < (int) sizeof(path)) {
+        path[rootLength] = '/';
+        path[rootLength + 1] = '\0';
+        if (scanDone(path, 1)) {
+            return;
+        }
+        path[rootLength] = '\0';
+    }
+
+    ScanFrame stack[MAX_PATH_DEPTH];
+    int depth = 0;
+    if (readScanFrame(path, &stack[0])) {
+        stack[0].pathLength = rootLength;
+        depth = 1;
+    }
+
+    while (depth > 0) {
+        ScanFrame* frame = &stack[depth - 1];
+        if (frame->next == frame->count) {
+            freeScanFrame(frame);
+            depth--;
+            continue;
+        }
+
+        const char* key = frame->keys[frame->next++];
+        size_t keyLength = strlen(key);
+        int isDir = key[keyLength - 1] == '/';
+        if (frame->pathLength + 1 + keyLength >= sizeof(path)) {
+            continue;
+        }
+        path[frame->pathLength] = '/';
+        memcpy(path + frame->pathLength + 1, key, keyLength + 1);
+        if (scanDone(path, isDir)) {
+            continue;
+        }
+        int length = frame->pathLength + 1 + (int) keyLength - isDir;
+        path[length] = '\0';
+
+        // Entries at or above the shard depth pick their shard, everything
+        // below a directory that did comes along with it
+        const char* relPath = path + rootLength + 1;
+        int decides = isDir ? shardDepth && depth == shardDepth : !shardDepth || depth <= shardDepth;
+        if (decides && !inShard(relPath)) {
+            continue;
+        }
+
+        if (!isDir) {
+            visit(path, context);
+        } else if (depth < MAX_PATH_DEPTH && readScanFrame(path, &stack[depth])) {
+            stack[depth].pathLength = length;
+            depth++;
+        } else {
+            LOG(LOG_WARN, "Cannot scan %s\n", path);
+        }
+    }
+}
+
+// Fixed memory summaries of a high cardinality field (volumes, servers,
+// extensions): a HyperLogLog for the number of distinct values, a count-min
+// sketch for their frequencies, and the values it currently ranks highest.
+#define HLL_BITS 12
+#define CMS_ROWS 4
+#define CMS_WIDTH 2048
+#define TOP_VALUES 20
+#define SKETCH_KEY_LEN 96
+
+typedef struct {
+    char key[SKETCH_KEY_LEN];
+    unsigned long long count;
+} TopValue;
+
+typedef struct {
+    const char* name;
+    unsigned char registers[1 << HLL_BITS];
+    unsigned long long counts[CMS_ROWS][CMS_WIDTH];
+    TopValue top[TOP_VALUES];
+    int topCount;
+    unsigned long long total;
+} Sketch;
+
+// FNV-1a mixes poorly into the high bits HyperLogLog reads, finish it off
+unsigned long long sketchHash(const char* key) {
+    unsigned long long hash = hashBytes(FNV_OFFSET, key, strlen(key));
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+void sketchAdd(Sketch* sketch, const char* key) {
+    unsigned long long hash = sketchHash(key);
+    sketch->total++;
+
+    // HyperLogLog: the top bits pick a register, which keeps the longest run
+    // of leading zeros seen in the rest
+    unsigned int index = (unsigned int) (hash >> (64 - HLL_BITS));
+    unsigned long long rest = (hash << HLL_BITS) | (1ULL << (HLL_BITS - 1));
+    unsigned char rank = (unsigned char) (__builtin_clzll(rest) + 1);
+    if (rank > sketch->registers[index]) {
+        sketch->registers[index] = rank;
+    }
+
+    // Count-min: the smallest of the row counters is the estimate
+    unsigned int h1 = (unsigned int) hash;
+    unsigned int h2 = (unsigned int) (hash >> 32) | 1;
+    unsigned long long estimate = ~0ULL;
+    for (int row = 0; row < CMS_ROWS; row++) {
+        unsigned long long* counter = &sketch->counts[row][(h1 + row * h2) % CMS_WIDTH];
+        (*counter)++;
+        estimate = *counter < estimate ? *counter : estimate;
+    }
+
+    // Keep the values with the highest estimates
+    int lowest = -1;
+    for (int i = 0; i < sketch->topCount; i++) {
+        if (strcmp(sketch->top[i].key, key) == 0) {
+            sketch->top[i].count = estimate;
+            return;
+        }
+        if (lowest < 0 || sketch->top[i].count < sketch->top[lowest].count) {
+            lowest = i;
+        }
+    }
+    int slot = sketch->topCount < TOP_VALUES ? sketch->topCount++ : lowest;
+    if (slot == lowest && sketch->top[slot].count >= estimate) {
+        return;
+    }
+    snprintf(sketch->top[slot].key, SKETCH_KEY_LEN, "%s", key);
+    sketch->top[slot].count = estimate;
+}
+
+// Natural logarithm for x >= 1, without pulling in libm for one call
+double naturalLog(double x) {
+    int exponent = 0;
+    while (x >= 2) {
+        x /= 2;
+        exponent++;
+    }
+    // ln(x) = 2 atanh((x - 1) / (x + 1)), quick to converge on [1, 2)
+    double z = (x - 1) / (x + 1);
+    double term = z;
+    double sum = 0;
+    for (int i = 1; i < 40; i += 2) {
+        sum += term / i;
+        term *= z * z;
+    }
+    return 2 * sum + exponent * 0.6931471805599453;
+}
+
+unsigned long long sketchDistinct(const Sketch* sketch) {
+    const int m = 1 << HLL_BITS;
+    double sum = 0;
+    int zeros = 0;
+    for (int i = 0; i < m; i++) {
+        sum += 1.0 / (double) (1ULL << sketch->registers[i]);
+        zeros += !sketch->registers[i];
+    }
+
+    double estimate = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+    // Few values: linear counting over the empty registers is more accurate
+    if (estimate <= 2.5 * m && zeros) {
+        estimate = m * naturalLog((double) m / zeros);
+    }
+    return (unsigned long long) (estimate + 0.5);
+}
+
+int compareTopValues(const void* a, const void* b) {
+    const TopValue* left = a;
+    const TopValue* right = b;
+    return (left->count < right->count) - (left->count > right->count);
+}
+
+void writeSketchJson(FILE* out, Sketch* sketch) {
+    qsort(sketch->top, sketch->topCount, sizeof(TopValue), compareTopValues);
+    fprintf(out, "\"%s\":{\"total\":%llu,\"distinct\":%llu,\"top\":[", sketch->name, sketch->total, sketchDistinct(sketch));
+    for (int i = 0; i < sketch->topCount; i++) {
+        fputs(i ? ",{\"value\":" : "{\"value\":", out);
+        writeJsonString(out, sketch->top[i].key);
+        fprintf(out, ",\"count\":%llu}", sketch->top[i].count);
+    }
+    fputs("]}", out);
+}
+
+// Everything --stats keeps, whatever the number of shortcuts scanned
+#define SIZE_BUCKETS 24
+
+typedef struct {
+    unsigned long long files;
+    unsigned long long outcomes[RESULT_UNREADABLE + 1];
+    unsigned long long driveLetters[27];      // A-Z, then anything else
+    unsigned long long sizes[SIZE_BUCKETS];   // Powers of two of the .lnk size
+    Sketch volumes;
+    Sketch servers;
+    Sketch extensions;
+} ScanStats;
+
+// Server of a UNC path, "\\server\share" -> "server"
+void uncServer(char* dest, int size, const char* unc) {
+    while (*unc == '\\' || *unc == '/') {
+        unc++;
+    }
+    int length = (int) strcspn(unc, "\\/");
+    snprintf(dest, size, "%.*s", length, unc);
+    for (char* p = dest; *p; p++) {
+        *p = (char) tolower((unsigned char) *p);
+    }
+}
+
+// Lower case extension of the last path component, "(none)" when it has none
+void pathExtension(char* dest, int size, const char* path) {
+    const char* base = path;
+    for (const char* p = path; *p; p++) {
+        if (*p == '/' || *p == '\\') {
+            base = p + 1;
+        }
+    }
+    const char* dot = strrchr(base, '.');
+    if (!dot || dot == base || !dot[1]) {
+        snprintf(dest, size, "(none)");
+        return;
+    }
+    snprintf(dest, size, "%s", dot + 1);
+    for (char* p = dest; *p; p++) {
+        *p = (char) tolower((unsigned char) *p);
+    }
+}
+
+void addScanStats(const char* lnkPath, void* context) {
+    ScanStats* stats = context;
+    LnkInfo info;
+    char* targetPath;
+    int result = resolveLnkFile(lnkPath, &targetPath, &info);
+
+    stats->files++;
+    stats->outcomes[result]++;
+    if (result == RESULT_UNREADABLE) {
+        return;
+    }
+
+    int bucket = 0;
+    while (bucket < SIZE_BUCKETS - 1 && (1LL << bucket) < info.lnkSize) {
+        bucket++;
+    }
+    stats->sizes[bucket]++;
+
+    // The drive letter the shortcut was made on: LinkInfo, the IDList, or the
+    // letter a network share was mapped to
+    const char* windowsPath = info.localBasePath[0] ? info.localBasePath : info.idListPath[0] ? info.idListPath : info.deviceName;
+    int letter = toupper((unsigned char) windowsPath[0]);
+    stats->driveLetters[letter >= 'A' && letter <= 'Z' && windowsPath[1] == ':' ? letter - 'A' : 26]++;
+
+    char value[SKETCH_KEY_LEN];
+    if (info.driveSerial || info.volumeLabel[0]) {
+        snprintf(value, sizeof(value), "%08X %s", info.driveSerial, info.volumeLabel);
+        sketchAdd(&stats->volumes, value);
+    }
+    if (info.netName[0]) {
+        uncServer(value, sizeof(value), info.netName);
+        sketchAdd(&stats->servers, value);
+    }
+    if (targetPath) {
+        pathExtension(value, sizeof(value), targetPath);
+        sketchAdd(&stats->extensions, value);
+    }
+    free(targetPath);
+}
+
+// --stats: scan every tree and print one JSON summary, no per shortcut output
+int scanStats(int count, char* roots[]) {
+    ScanStats* stats = calloc(1, sizeof(ScanStats));
+    if (!stats) {
+        perror("Failed to allocate the scan statistics");
+        return 1;
+    }
+    stats->volumes.name = "volumes";
+    stats->servers.name = "unc_servers";
+    stats->extensions.name = "extensions";
+
+    for (int i = 0; i < count; i++) {
+        scanTree(roots[i], addScanStats, stats);
+    }
+
+    printf("{\"files\":%llu,\"outcomes\":{", stats->files);
+    for (int i = 0; i <= RESULT_UNREADABLE; i++) {
+        printf("%s\"%s\":%llu", i ? "," : "", resultNames[i], stats->outcomes[i]);
+    }
+    fputs("},\"drive_letters\":{", stdout);
+    int first = 1;
+    for (int i = 0; i < 27; i++) {
+        if (stats->driveLetters[i]) {
+            char letter[2] = {(char) ('A' + i), '\0'};
+            printf("%s\"%s\":%llu", first ? "" : ",", i < 26 ? letter : "other", stats->driveLetters[i]);
+            first = 0;
+        }
+    }
+    fputs("},\"lnk_size\":[", stdout);
+    first = 1;
+    for (int i = 0; i < SIZE_BUCKETS; i++) {
+        if (stats->sizes[i]) {
+            printf("%s{\"le\":%lld,\"count\":%llu}", first ? "" : ",", 1LL << i, stats->sizes[i]);
+            first = 0;
+        }
+    }
+    fputs("],", stdout);
+    writeSketchJson(stdout, &stats->volumes);
+    fputc(',', stdout);
+    writeSketchJson(stdout, &stats->servers);
+    fputc(',', stdout);
+    writeSketchJson(stdout, &stats->extensions);
+    fputs("}\n", stdout);
+
+    free(stats);
+    return 0;
+}
+
+// Roots in the order their files sort, "a.b" before "a" since '.' < '/'
+int compareScanRoots(const void* a, const void* b) {
+    char left[PATH_MAX + 1];
+    char right[PATH_MAX + 1];
+    snprintf(left, sizeof(left), "%s/", *(char* const*) a);
+    snprintf(right, sizeof(right), "%s/", *(char* const*) b);
+    return strcmp(left, right);
+}
+
+// --checkpoint FILE: a long --scan saves its progress every CHECKPOINT_INTERVAL
+// seconds, and --resume continues from it. Since the walk is sorted, the last
+// finished path stands for the whole frontier and every completed subtree.
+// The checkpoint also keeps the output size at that point, so records written
+// after it are cut off again on resume.
+#define CHECKPOINT_INTERVAL 5
+
+char checkpointFile[MAX_PATH_LEN] = "";
+int resumeScan = 0;
+int scanFinished = 0;
+char lastScanned[PATH_MAX] = "";
+long long lastCheckpoint = 0;
+
+// Flush a rename to disk: it is recorded in the folder holding the file
+void syncParentDir(const char* path) {
+    char dir[MAX_PATH_LEN];
+    const char* lastSlash = strrchr(path, '/');
+    if (lastSlash) {
+        snprintf(dir, sizeof(dir), "%.*s", (int) (lastSlash - path + (lastSlash == path)), path);
+    } else {
+        strcpy(dir, ".");
+    }
+    int fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+// Replaced in one rename, a kill or a crash at any point leaves the previous
+// checkpoint whole. The output is synced first, so the offset recorded is on
+// disk by the time the checkpoint is.
+int writeCheckpoint(const char* lastPath, int done) {
+    fflush(stdout);
+    long long offset = ftell(stdout);
+    struct stat st;
+    if (fstat(STDOUT_FILENO, &st) == 0 && S_ISREG(st.st_mode)) {
+        fsync(STDOUT_FILENO);
+    }
+
+    // A temporary file of its own, another run may checkpoint next to this one
+    char tmpPath[MAX_PATH_LEN + 8];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.XXXXXX", checkpointFile);
+    int fd = mkstemp(tmpPath);
+    FILE* out = fd >= 0 ? fdopen(fd, "w") : NULL;
+    if (!out) {
+        perror("Failed to write the checkpoint");
+        if (fd >= 0) {
+            close(fd);
+            unlink(tmpPath);
+        }
+        return 0;
+    }
+    fprintf(out, "open_lnk checkpoint 1\nshard %d %d %d\noffset %lld\ndone %d\nlast %s\n", shardIndex, shardCount, shardDepth, offset, done, lastPath);
+    int written = fflush(out) == 0 && fsync(fd) == 0;
+    if (fclose(out) != 0 || !written || rename(tmpPath, checkpointFile) != 0) {
+        perror("Failed to write the checkpoint");
+        unlink(tmpPath);
+        return 0;
+    }
+    syncParentDir(checkpointFile);
+    lastCheckpoint = monotonicMicros();
+    return 1;
+}
+
+// Load the checkpoint and cut the output back to where it was taken
+int readCheckpoint(void) {
+    FILE* in = fopen(checkpointFile, "r");
+    if (!in) {
+        perror("Failed to read the checkpoint");
+        return 0;
+    }
+
+    char header[64];
+    int index, count, depth;
+    long long offset;
+    int valid = fgets(header, sizeof(header), in) && strcmp(header, "open_lnk checkpoint 1\n") == 0
+        && fscanf(in, "shard %d %d %d\noffset %lld\ndone %d\nlast ", &index, &count, &depth, &offset, &scanFinished) == 5
+        && fgets(resumeAfter, sizeof(resumeAfter), in);
+    fclose(in);
+    resumeAfter[strcspn(resumeAfter, "\n")] = '\0';
+    if (!valid) {
+        fprintf(stderr, "%s is not a checkpoint\n", checkpointFile);
+        return 0;
+    }
+    if (index != shardIndex || count != shardCount || depth != shardDepth) {
+        fprintf(stderr, "The checkpoint was taken with --shard %d/%d --shard-depth %d\n", index, count, depth);
+        return 0;
+    }
+
+    // Append with >> to resume into the same output. Anything else, such as >
+    // having emptied it, would leave a hole of NUL bytes in front of the records.
+    struct stat st;
+    if (offset >= 0 && fstat(STDOUT_FILENO, &st) == 0 && S_ISREG(st.st_mode)) {
+        int appending = (fcntl(STDOUT_FILENO, F_GETFL) & O_APPEND) || lseek(STDOUT_FILENO, 0, SEEK_CUR) == st.st_size;
+        if (st.st_size < offset || !appending) {
+            fprintf(stderr, "The output is not the one checkpointed (%lld bytes, %lld expected), resume with >> into it\n",
+                (long long) st.st_size, offset);
+            return 0;
+        }
+        if (ftruncate(STDOUT_FILENO, offset) != 0 || fseek(stdout, offset, SEEK_SET) != 0) {
+            perror("Failed to cut the output back to the checkpoint");
+            return 0;
+        }
+    }
+    LOG(LOG_INFO, "Resuming after %s\n", resumeAfter);
+    return 1;
+}
+
+void printAndCheckpoint(const char* lnkPath, void* context) {
+    printResolved(lnkPath, context);
+    snprintf(lastScanned, sizeof(lastScanned), "%s", lnkPath);
+    if (monotonicMicros() - lastCheckpoint >= CHECKPOINT_INTERVAL * 1000000LL) {
+        writeCheckpoint(lnkPath, 0);
+    }
+}
+
+// --scan: --resolve over every .lnk below the roots. Records come out sorted by path.
+int scanResolve(int count, char* roots[]) {
+    qsort(roots, count, sizeof(char*), compareScanRoots);
+    if (resumeScan && !readCheckpoint()) {
+        return 1;
+    }
+    if (scanFinished) {
+        return 0;
+    }
+    snprintf(lastScanned, sizeof(lastScanned), "%s", resumeAfter);
+
+    ScanVisitor visit = printResolved;
+    if (checkpointFile[0]) {
+        visit = printAndCheckpoint;
+        lastCheckpoint = monotonicMicros();
+    }
+    for (int i = 0; i < count; i++) {
+        scanTree(roots[i], visit, NULL);
+    }
+#ifdef LNK_ALLOC_STATS
+    atomic_store(&allocSteady, 0);
+#endif
+
+    // The final checkpoint marks the scan done, resuming from it is a no-op
+    if (checkpointFile[0]) {
+        writeCheckpoint(lastScanned, 1);
+    }
+    return 0;
+}
+
+// Decode the string value of field from one of our JSON records. Only the
+// escapes writeJsonString() produces are understood. Returns its length, or
+// -1 when the field is missing or does not fit.
+int readJsonField(const char* line, const char* field, char* out, int size) {
+    char key[64];
+    snprintf(key, sizeof(key), "\"%s\":\"", field);
+    const char* p = strstr(line, key);
+    if (!p) {
+        return -1;
+    }
+
+    int length = 0;
+    for (p += strlen(key); *p && *p != '"'; p++) {
+        char c = *p;
+        if (c == '\\' && p[1] == 'u' && isxdigit((unsigned char) p[2])) {
+            c = (char) strtol((char[]) {p[4], p[5], '\0'}, NULL, 16);
+            p += 5;
+        } else if (c == '\\' && p[1]) {
+            c = *++p;
+        }
+        if (length == size - 1) {
+            return -1;
+        }
+        out[length++] = c;
+    }
+    out[length] = '\0';
+    return *p == '"' ? length : -1;
+}
+
+// Read the next record, skipping lines without a path. Returns 0 at the end.
+int advanceMergeInput(MergeInput* input) {
+    while (getline(&input->line, &input->capacity, input->file) > 0) {
+        if (readJsonField(input->line, "lnk", input->key, sizeof(input->key)) >= 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Min-heap on the current path, ties broken by input order
+int mergeBefore(MergeInput* inputs, int a, int b) {
+    int order = strcmp(inputs[a].key, inputs[b].key);
+    return order < 0 || (order == 0 && a < b);
+}
+
+void siftDown(MergeInput* inputs, int* heap, int count, int at) {
+    for (;;) {
+        int smallest = at;
+        int left = at * 2 + 1;
+        int right = left + 1;
+        if (left < count && mergeBefore(inputs, heap[left], heap[smallest])) {
+            smallest = left;
+        }
+        if (right < count && mergeBefore(inputs, heap[right], heap[smallest])) {
+            smallest = right;
+        }
+        if (smallest == at) {
+            return;
+        }
+        int swap = heap[at];
+        heap[at] = heap[smallest];
+        heap[smallest] = swap;
+        at = smallest;
+    }
+}
+
+// k-way merge of the inputs into out by path. Memory is one line per input.
+// Returns 0 when the heap could not be allocated.
+int mergeInputs(MergeInput* inputs, int count, FILE* out) {
+    int* heap = malloc((count ? count : 1) * sizeof(int));
+    if (!heap) {
+        perror("Failed to allocate the merge heap");
+        return 0;
+    }
+
+    int live = 0;
+    for (int i = 0; i < count; i++) {
+        if (inputs[i].file && advanceMergeInput(&inputs[i])) {
+            heap[live++] = i;
+        }
+    }
+    for (int i = live / 2 - 1; i >= 0; i--) {
+        siftDown(inputs, heap, live, i);
+    }
+
+    char previous[PATH_MAX] = "";
+    while (live > 0) {
+        MergeInput* top = &inputs[heap[0]];
+        if (strcmp(top->key, previous) < 0) {
+            LOG(LOG_WARN, "Input is not sorted at %s\n", top->key);
+        }
+        snprintf(previous, sizeof(previous), "%s", top->key);
+        fputs(top->line, out);
+
+        if (!advanceMergeInput(top)) {
+            heap[0] = heap[--live];
+        }
+        siftDown(inputs, heap, live, 0);
+    }
+    free(heap);
+    return 1;
+}
+
+// --merge: k-way merge of sorted --scan outputs, such as the shards of one scan,
+// into one sorted stream
+int mergeOutputs(int count, char* paths[]) {
+    MergeInput* inputs = calloc(count ? count : 1, sizeof(MergeInput));
+    if (!inputs) {
+        perror("Failed to allocate the merge inputs");
+        return 1;
+    }
+
+    int status = 0;
+    for (int i = 0; i < count; i++) {
+        inputs[i].file = strcmp(paths[i], "-") == 0 ? stdin : fopen(paths[i], "r");
+        if (!inputs[i].file) {
+            perror(paths[i]);
+            status = 1;
+        }
+    }
+    if (!mergeInputs(inputs, count, stdout)) {
+        status = 1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (inputs[i].file && inputs[i].file != stdin) {
+            fclose(inputs[i].file);
+        }
+        free(inputs[i].line);
+    }
+    free(inputs);
+    return status;
+}
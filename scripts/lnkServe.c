@@ -0,0 +1,212 @@
+// --stdin-stream and --coproc: resolving shortcuts for another process over pipes
+
+#include "lnkInternal.h"
+
+
+/*
+____ ____ ____ _  _ ____ 
+[__  |___ |__/ |  | |___ 
+___] |___ |  \  \/  |___ 
+
+*/
+
+// --stdin-stream: shortcuts arrive on stdin one after the other, each after its
+// length as 4 bytes little-endian, and get one JSON line each in order. Output
+// is flushed whenever stdin has nothing buffered, so a scanner can hand over
+// one shortcut and wait for its answer.
+#define STREAM_MAX_BLOB (64 << 20)
+
+typedef struct {
+    unsigned char buffer[65536];
+    size_t start;
+    size_t end;
+} StdinReader;
+
+// Copy size bytes from stdin to out, or drop them when out is NULL. Returns 0
+// at the end of the input.
+int readStdin(StdinReader* reader, unsigned char* out, size_t size) {
+    while (size) {
+        if (reader->start == reader->end) {
+            fflush(stdout);
+            ssize_t got = read(STDIN_FILENO, reader->buffer, sizeof(reader->buffer));
+            if (got < 0 && errno == EINTR) {
+                continue;
+            }
+            if (got <= 0) {
+                return 0;
+            }
+            reader->start = 0;
+            reader->end = got;
+        }
+        size_t chunk = reader->end - reader->start < size ? reader->end - reader->start : size;
+        if (out) {
+            memcpy(out, reader->buffer + reader->start, chunk);
+            out += chunk;
+        }
+        reader->start += chunk;
+        size -= chunk;
+    }
+    return 1;
+}
+
+int resolveStdinStream(void) {
+    static StdinReader reader;
+    unsigned char data[MAX_DATA_SIZE];
+    unsigned char prefix[4];
+    for (unsigned long index = 0; readStdin(&reader, prefix, sizeof(prefix)); index++) {
+        unsigned int length = readU32(prefix);
+        if (length > STREAM_MAX_BLOB) {
+            fprintf(stderr, "Shortcut %lu is %u bytes long, the stream is out of step\n", index, length);
+            return 1;
+        }
+
+        // Like a file, a shortcut is resolved from its first MAX_DATA_SIZE bytes
+        unsigned int kept = length < sizeof(data) ? length : sizeof(data);
+        if (!readStdin(&reader, data, kept) || !readStdin(&reader, NULL, length - kept)) {
+            fprintf(stderr, "Shortcut %lu is cut short\n", index);
+            return 1;
+        }
+        char* targetPath;
+        int result = lnkResolveBuffer(data, kept, NULL, &targetPath);
+        printf("{\"index\":%lu,\"status\":\"%s\"", index, resultNames[result]);
+        if (targetPath) {
+            fputs(",\"target\":", stdout);
+            writeJsonString(stdout, targetPath);
+        }
+        fputs("}\n", stdout);
+        free(targetPath);
+    }
+    return 0;
+}
+
+// --coproc [WORKERS]: a long-lived helper for file managers. Each stdin line is
+// a request "ID<TAB>PATH", answered by one JSON line carrying the same ID as soon
+// as it is resolved, so answers may come out of order. WORKERS threads resolve
+// requests at once and a slow share holds up only its own answers.
+#define COPROC_QUEUE_SIZE 1024
+
+typedef struct {
+    char* requests[COPROC_QUEUE_SIZE];  // Lines waiting for a worker
+    int head;
+    int count;
+    int closed;                         // stdin has ended
+    pthread_mutex_t lock;
+    pthread_cond_t notEmpty;
+    pthread_cond_t notFull;
+    pthread_mutex_t outputLock;         // One answer at a time on stdout
+} CoprocQueue;
+
+// Take the next request, NULL once stdin has ended and the queue is empty
+char* nextCoprocRequest(CoprocQueue* queue) {
+    pthread_mutex_lock(&queue->lock);
+    while (!queue->count && !queue->closed) {
+        pthread_cond_wait(&queue->notEmpty, &queue->lock);
+    }
+    char* request = NULL;
+    if (queue->count) {
+        request = queue->requests[queue->head];
+        queue->head = (queue->head + 1) % COPROC_QUEUE_SIZE;
+        queue->count--;
+        pthread_cond_signal(&queue->notFull);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return request;
+}
+
+void* coprocWorker(void* arg) {
+    CoprocQueue* queue = arg;
+    char* request;
+    while ((request = nextCoprocRequest(queue))) {
+        char* path = strchr(request, '\t');
+        *path++ = '\0';
+        char* targetPath;
+        LnkInfo info;
+        int result = resolveLnkFile(path, &targetPath, &info);
+
+        pthread_mutex_lock(&queue->outputLock);
+        fputs("{\"id\":", stdout);
+        writeJsonString(stdout, request);
+        printf(",\"status\":\"%s\"", resultNames[result]);
+        if (targetPath) {
+            fputs(",\"target\":", stdout);
+            writeJsonString(stdout, targetPath);
+        }
+        if (info.iconLocation[0]) {
+            fputs(",\"icon\":", stdout);
+            writeJsonString(stdout, info.iconLocation);
+            printf(",\"icon_index\":%d", info.iconIndex);
+        }
+        fputs("}\n", stdout);
+
+        // Flush once no request is waiting, the answers to those would follow at once
+        pthread_mutex_lock(&queue->lock);
+        int waiting = queue->count;
+        pthread_mutex_unlock(&queue->lock);
+        if (!waiting) {
+            fflush(stdout);
+        }
+        pthread_mutex_unlock(&queue->outputLock);
+
+        free(targetPath);
+        free(request);
+    }
+    return NULL;
+}
+
+int runCoproc(int workerCount) {
+    CoprocQueue queue;
+    memset(&queue, 0, sizeof(queue));
+    pthread_mutex_init(&queue.lock, NULL);
+    pthread_cond_init(&queue.notEmpty, NULL);
+    pthread_cond_init(&queue.notFull, NULL);
+    pthread_mutex_init(&queue.outputLock, NULL);
+
+    pthread_t workers[COPROC_MAX_WORKERS];
+    int started = 0;
+    while (started < workerCount && pthread_create(&workers[started], NULL, coprocWorker, &queue) == 0) {
+        started++;
+    }
+    if (!started) {
+        perror("Failed to start the workers");
+        return 1;
+    }
+
+    char* line = NULL;
+    size_t capacity = 0;
+    ssize_t length;
+    while ((length = getline(&line, &capacity, stdin)) > 0) {
+        while (length && (line[length - 1] == '\n' || line[length - 1] == '\r')) {
+            line[--length] = '\0';
+        }
+        if (!strchr(line, '\t')) {
+            LOG(LOG_WARN, "Ignoring a request without a tab: %s\n", line);
+            continue;
+        }
+        char* request = strdup(line);
+        if (!request) {
+            perror("Failed to queue a request");
+            continue;
+        }
+
+        pthread_mutex_lock(&queue.lock);
+        while (queue.count == COPROC_QUEUE_SIZE) {
+            pthread_cond_wait(&queue.notFull, &queue.lock);
+        }
+        queue.requests[(queue.head + queue.count) % COPROC_QUEUE_SIZE] = request;
+        queue.count++;
+        pthread_cond_signal(&queue.notEmpty);
+        pthread_mutex_unlock(&queue.lock);
+    }
+    free(line);
+
+    // Answer what is left, then leave
+    pthread_mutex_lock(&queue.lock);
+    queue.closed = 1;
+    pthread_cond_broadcast(&queue.notEmpty);
+    pthread_mutex_unlock(&queue.lock);
+    for (int i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    fflush(stdout);
+    return 0;
+}
@@ -0,0 +1,275 @@
+// Python bindings: parse and resolve shortcuts from Python without a process per
+// file. Buffers are read in place through the buffer protocol, the GIL is
+// released while C code runs, and resolve_files() spreads a list of paths over
+// native threads.
+//
+//   python3 setup.py build_ext --inplace
+//
+//   import open_lnk
+//   open_lnk.parse(data)                  # dict of the recorded fields, or None
+//   open_lnk.resolve(data, name=None)     # (status, target)
+//   open_lnk.resolve_file(path)           # (status, target)
+//   open_lnk.resolve_files(paths, threads=8)
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "../lnkInternal.h"
+
+#define MAX_BATCH_THREADS 64
+
+// A str from C, undecodable bytes of ANSI strings kept as surrogates
+PyObject* makeString(const char* value) {
+    return PyUnicode_DecodeUTF8(value, strlen(value), "surrogateescape");
+}
+
+// (status, target) with None for a missing target
+PyObject* makeResult(int result, const char* targetPath) {
+    if (targetPath) {
+        return Py_BuildValue("(sN)", resultNames[result], makeString(targetPath));
+    }
+    return Py_BuildValue("(sO)", resultNames[result], Py_None);
+}
+
+// Add one str field to the parse() dict, skipped when empty
+int addField(PyObject* dict, const char* key, const char* value) {
+    if (!value || !value[0]) {
+        return 0;
+    }
+    PyObject* item = makeString(value);
+    if (!item) {
+        return -1;
+    }
+    int failed = PyDict_SetItemString(dict, key, item);
+    Py_DECREF(item);
+    return failed;
+}
+
+PyObject* parseInfo(const LnkInfo* info, const char* target) {
+    PyObject* dict = Py_BuildValue("{s:I,s:I,s:I,s:I,s:i}",
+        "flags", info->linkFlags, "drive_type", info->driveType, "volume_serial", info->driveSerial,
+        "target_size", info->fileSize, "icon_index", info->iconIndex);
+    if (!dict) {
+        return NULL;
+    }
+    PyObject* mtime = info->writeTime ? PyLong_FromLongLong(filetimeToUnix(info->writeTime)) : Py_NewRef(Py_None);
+    if (!mtime || PyDict_SetItemString(dict, "target_mtime", mtime) != 0
+        || addField(dict, "target", target)
+        || addField(dict, "local_base_path", info->localBasePath)
+        || addField(dict, "common_path_suffix", info->commonPathSuffix)
+        || addField(dict, "share", info->netName)
+        || addField(dict, "device", info->deviceName)
+        || addField(dict, "volume_label", info->volumeLabel)
+        || addField(dict, "relative_path", info->relativePath)
+        || addField(dict, "environment_path", info->environmentPath)
+        || addField(dict, "id_list_path", info->idListPath)
+        || addField(dict, "known_folder_path", info->knownFolderSubPath)
+        || addField(dict, "icon", info->iconLocation)) {
+        Py_XDECREF(mtime);
+        Py_DECREF(dict);
+        return NULL;
+    }
+    Py_DECREF(mtime);
+    return dict;
+}
+
+// parse(data): the fields of the shortcut as recorded, None when it is not one
+PyObject* pyParse(PyObject* self, PyObject* arg) {
+    (void) self;
+    Py_buffer view;
+    if (PyObject_GetBuffer(arg, &view, PyBUF_SIMPLE) != 0) {
+        return NULL;
+    }
+    LnkInfo* info = malloc(sizeof(LnkInfo));
+    if (!info) {
+        PyBuffer_Release(&view);
+        return PyErr_NoMemory();
+    }
+
+    int valid;
+    char* target = NULL;
+    Py_BEGIN_ALLOW_THREADS
+    valid = parseLnk(view.buf, view.len < INT_MAX ? (int) view.len : INT_MAX, info);
+    if (valid) {
+        target = recordedTarget(info);
+    }
+    Py_END_ALLOW_THREADS
+    PyBuffer_Release(&view);
+
+    PyObject* result = valid ? parseInfo(info, target) : Py_NewRef(Py_None);
+    free(target);
+    free(info);
+    return result;
+}
+
+// resolve(data, name=None): look for the target of a shortcut held in memory
+PyObject* pyResolve(PyObject* self, PyObject* args, PyObject* kwargs) {
+    (void) self;
+    static char* keywords[] = {"data", "name", NULL};
+    Py_buffer view;
+    PyObject* nameBytes = NULL;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "y*|O&", keywords, &view, PyUnicode_FSConverter, &nameBytes)) {
+        return NULL;
+    }
+
+    int result;
+    char* targetPath;
+    const char* name = nameBytes ? PyBytes_AS_STRING(nameBytes) : NULL;
+    Py_BEGIN_ALLOW_THREADS
+    result = lnkResolveBuffer(view.buf, view.len, name, &targetPath);
+    Py_END_ALLOW_THREADS
+    PyBuffer_Release(&view);
+    Py_XDECREF(nameBytes);
+
+    PyObject* value = makeResult(result, targetPath);
+    free(targetPath);
+    return value;
+}
+
+// resolve_file(path): what open_lnk --resolve says about one shortcut
+PyObject* pyResolveFile(PyObject* self, PyObject* arg) {
+    (void) self;
+    PyObject* pathBytes;
+    if (!PyUnicode_FSConverter(arg, &pathBytes)) {
+        return NULL;
+    }
+    lnkInit();
+
+    int result;
+    char* targetPath;
+    LnkInfo* info = malloc(sizeof(LnkInfo));
+    if (!info) {
+        Py_DECREF(pathBytes);
+        return PyErr_NoMemory();
+    }
+    Py_BEGIN_ALLOW_THREADS
+    result = resolveLnkFile(PyBytes_AS_STRING(pathBytes), &targetPath, info);
+    Py_END_ALLOW_THREADS
+    Py_DECREF(pathBytes);
+    free(info);
+
+    PyObject* value = makeResult(result, targetPath);
+    free(targetPath);
+    return value;
+}
+
+// A batch shared by the threads of resolve_files(), which take paths in turn
+typedef struct {
+    char** paths;
+    int* results;
+    char** targets;
+    Py_ssize_t count;
+    atomic_long next;
+} ResolveBatch;
+
+void* resolveBatchThread(void* arg) {
+    ResolveBatch* batch = arg;
+    LnkInfo* info = malloc(sizeof(LnkInfo));
+    if (!info) {
+        return NULL;
+    }
+    long i;
+    while ((i = atomic_fetch_add(&batch->next, 1)) < batch->count) {
+        batch->results[i] = resolveLnkFile(batch->paths[i], &batch->targets[i], info);
+    }
+    free(info);
+    return NULL;
+}
+
+// resolve_files(paths, threads=8): [(status, target), ...] in the order of paths
+PyObject* pyResolveFiles(PyObject* self, PyObject* args, PyObject* kwargs) {
+    (void) self;
+    static char* keywords[] = {"paths", "threads", NULL};
+    PyObject* paths;
+    int threadCount = 8;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|i", keywords, &paths, &threadCount)) {
+        return NULL;
+    }
+    if (threadCount < 1 || threadCount > MAX_BATCH_THREADS) {
+        return PyErr_Format(PyExc_ValueError, "threads must be between 1 and %d", MAX_BATCH_THREADS);
+    }
+    PyObject* sequence = PySequence_Fast(paths, "paths must be a sequence");
+    if (!sequence) {
+        return NULL;
+    }
+    lnkInit();
+
+    // Paths are converted while the GIL is held, the threads only see C strings
+    ResolveBatch batch;
+    memset(&batch, 0, sizeof(batch));
+    batch.count = PySequence_Fast_GET_SIZE(sequence);
+    PyObject** pathBytes = PyMem_Calloc(batch.count ? batch.count : 1, sizeof(PyObject*));
+    batch.paths = PyMem_Calloc(batch.count ? batch.count : 1, sizeof(char*));
+    batch.results = PyMem_Calloc(batch.count ? batch.count : 1, sizeof(int));
+    batch.targets = PyMem_Calloc(batch.count ? batch.count : 1, sizeof(char*));
+    PyObject* list = NULL;
+    if (!pathBytes || !batch.paths || !batch.results || !batch.targets) {
+        PyErr_NoMemory();
+        goto done;
+    }
+    for (Py_ssize_t i = 0; i < batch.count; i++) {
+        if (!PyUnicode_FSConverter(PySequence_Fast_GET_ITEM(sequence, i), &pathBytes[i])) {
+            goto done;
+        }
+        batch.paths[i] = PyBytes_AS_STRING(pathBytes[i]);
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    pthread_t threads[MAX_BATCH_THREADS];
+    int started = 0;
+    while (started < threadCount && started < batch.count
+        && pthread_create(&threads[started], NULL, resolveBatchThread, &batch) == 0) {
+        started++;
+    }
+    // Whatever no thread took is done here
+    resolveBatchThread(&batch);
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    Py_END_ALLOW_THREADS
+
+    list = PyList_New(batch.count);
+    for (Py_ssize_t i = 0; list && i < batch.count; i++) {
+        PyObject* value = makeResult(batch.results[i], batch.targets[i]);
+        if (!value) {
+            Py_CLEAR(list);
+            break;
+        }
+        PyList_SET_ITEM(list, i, value);
+    }
+
+done:
+    for (Py_ssize_t i = 0; i < batch.count; i++) {
+        if (pathBytes) {
+            Py_XDECREF(pathBytes[i]);
+        }
+        if (batch.targets) {
+            free(batch.targets[i]);
+        }
+    }
+    PyMem_Free(pathBytes);
+    PyMem_Free(batch.paths);
+    PyMem_Free(batch.results);
+    PyMem_Free(batch.targets);
+    Py_DECREF(sequence);
+    return list;
+}
+
+PyMethodDef openLnkMethods[] = {
+    {"parse", pyParse, METH_O, "parse(data) -> dict or None\n\nFields of a shortcut held in a bytes-like object, as recorded."},
+    {"resolve", (PyCFunction) (void (*)(void)) pyResolve, METH_VARARGS | METH_KEYWORDS,
+        "resolve(data, name=None) -> (status, target)\n\nFind the target of a shortcut held in a bytes-like object."},
+    {"resolve_file", pyResolveFile, METH_O, "resolve_file(path) -> (status, target)\n\nFind the target of a .lnk file."},
+    {"resolve_files", (PyCFunction) (void (*)(void)) pyResolveFiles, METH_VARARGS | METH_KEYWORDS,
+        "resolve_files(paths, threads=8) -> [(status, target), ...]\n\nResolve many .lnk files on native threads."},
+    {NULL, NULL, 0, NULL}
+};
+
+struct PyModuleDef openLnkModule = {
+    PyModuleDef_HEAD_INIT, "open_lnk", "Read and resolve Windows shortcuts (.lnk).", -1, openLnkMethods,
+    NULL, NULL, NULL, NULL
+};
+
+PyMODINIT_FUNC PyInit_open_lnk(void) {
+    return PyModule_Create(&openLnkModule);
+}
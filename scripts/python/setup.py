@@ -0,0 +1,20 @@
+# Builds the open_lnk Python module from the library files of open_lnk:
+#   python3 setup.py build_ext --inplace
+
+from setuptools import Extension, setup
+
+setup(
+    name="open_lnk",
+    version="1.0",
+    description="Read and resolve Windows shortcuts (.lnk)",
+    ext_modules=[
+        Extension(
+            "open_lnk",
+            sources=["openLnkModule.c", "../lnkLog.c", "../lnkMetrics.c", "../lnkParse.c", "../lnkResolve.c"],
+            depends=["../lnkInternal.h", "../lnkReader.h"],
+            # Only PyInit_open_lnk is exported, the library files stay inside
+            extra_compile_args=["-pthread", "-fvisibility=hidden"],
+            extra_link_args=["-pthread"],
+        )
+    ],
+)
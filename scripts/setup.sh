@@ -1,7 +1,7 @@
 #!/bin/bash
 
-# Compiling lnkReader.c into open_lnk
-gcc lnkReader.c -o open_lnk
+# Compiling the lnk*.c files into open_lnk
+gcc lnk*.c -o open_lnk -pthread
 
 # Creating the .desktop file
 echo "[Desktop Entry]